@@ -18,13 +18,19 @@
 #include "patchcanvas/patchcanvas.cpp"
 #include "patchcanvas/patchcanvas-theme.cpp"
 #include "patchcanvas/patchscene.cpp"
+#include "patchcanvas/canvasarrange.cpp"
 #include "patchcanvas/canvasbezierline.cpp"
 #include "patchcanvas/canvasbezierlinemov.cpp"
 #include "patchcanvas/canvasbox.cpp"
+#include "patchcanvas/canvasboxgrid.cpp"
 #include "patchcanvas/canvasboxshadow.cpp"
-#include "patchcanvas/canvasfadeanimation.cpp"
+#include "patchcanvas/canvascommandqueue.cpp"
 #include "patchcanvas/canvasicon.cpp"
+#include "patchcanvas/canvasiconcache.cpp"
+#include "patchcanvas/canvaslayoutstore.cpp"
 #include "patchcanvas/canvasline.cpp"
 #include "patchcanvas/canvaslinemov.cpp"
+#include "patchcanvas/canvaslinelayer.cpp"
+#include "patchcanvas/canvaslayerline.cpp"
 #include "patchcanvas/canvasport.cpp"
-#include "patchcanvas/canvasportglow.cpp"
+#include "patchcanvas/canvassearchindex.cpp"
@@ -86,6 +86,8 @@ struct options_t {
     bool use_bezier_lines;
     AntialiasingOption antialiasing;
     EyeCandyOption eyecandy;
+    bool use_line_layer; // draw all connections with a single scene item, kept just below the top box
+    bool use_item_cache; // keep boxes, ports and icons rendered in pixmap caches
 };
 
 // Canvas features
@@ -97,6 +99,28 @@ struct features_t {
     bool handle_group_pos;
 };
 
+// Bulk insertion descriptors
+struct group_info_t {
+    int group_id;
+    QString group_name;
+    SplitOption split; // SPLIT_UNDEF keeps the current split state
+    Icon icon;
+};
+
+struct port_info_t {
+    int group_id;
+    int port_id;
+    QString port_name;
+    PortMode port_mode;
+    PortType port_type;
+};
+
+struct connection_info_t {
+    int connection_id;
+    int port_out_id;
+    int port_in_id;
+};
+
 typedef void (*Callback) (CallbackAction action, int value1, int value2, QString value_str);
 
 // API starts here
@@ -105,6 +129,10 @@ void setFeatures(features_t* features);
 void init(PatchScene* scene, Callback callback, bool debug=false);
 void clear();
 
+// Batch updates, layout and repaints are deferred until the outermost endUpdate()
+void beginUpdate();
+void endUpdate();
+
 void setInitialPos(int x, int y);
 void setCanvasSize(int x, int y, int width, int height);
 
@@ -118,16 +146,52 @@ void setGroupPos(int group_id, int group_pos_x, int group_pos_y);
 void setGroupPos(int group_id, int group_pos_x, int group_pos_y, int group_pos_xs, int group_pos_ys);
 void setGroupIcon(int group_id, Icon icon);
 
+// Collapsed groups show one summary port per port mode and type instead of every port,
+// their port items are only created once the group gets expanded again.
+void setGroupCollapsed(int group_id, bool collapsed);
+bool isGroupCollapsed(int group_id);
+
 void addPort(int group_id, int port_id, QString port_name, PortMode port_mode, PortType port_type);
+void addPorts(const QList<port_info_t>& ports);
 void removePort(int port_id);
 void renamePort(int port_id, QString new_port_name);
 
 void connectPorts(int connection_id, int port_out_id, int port_in_id);
+void connectPortsBulk(const QList<connection_info_t>& connections);
 void disconnectPorts(int connection_id);
 
-void arrange();
+// Makes the canvas match a full snapshot of the graph, only the differences get applied, in one batch
+void applyGraph(const QList<group_info_t>& groups, const QList<port_info_t>& ports, const QList<connection_info_t>& connections);
+
+// Port search over "group:port" names, kept up to date by the calls above.
+// Every whitespace separated word has to match somewhere, case insensitive.
+QList<int> searchPorts(const QString& text);
+// Highlights the given ports (an empty list clears) and optionally scrolls them into view
+void highlightPorts(const QList<int>& port_ids, bool focus=true);
+
+// Thread-safe versions of the calls above, for callbacks running outside the GUI thread (JACK).
+// Commands go through a lock-free queue and are applied once per frame, in one batch; a command
+// cancelled within the same frame (added, then removed) never reaches the scene.
+// Names are UTF-8, cut at 255 bytes. A full queue returns false, resync with applyGraph() then.
+bool queueAddGroup(int group_id, const char* group_name, SplitOption split=SPLIT_UNDEF, Icon icon=ICON_APPLICATION);
+bool queueRemoveGroup(int group_id);
+bool queueRenameGroup(int group_id, const char* new_group_name);
+bool queueAddPort(int group_id, int port_id, const char* port_name, PortMode port_mode, PortType port_type);
+bool queueRemovePort(int port_id);
+bool queueRenamePort(int port_id, const char* new_port_name);
+bool queueConnectPorts(int connection_id, int port_out_id, int port_in_id);
+bool queueDisconnectPorts(int connection_id);
+
+// Lay out groups by signal flow, computed in the background and applied in one batch.
+// Incremental mode only places groups the user has not positioned yet.
+void arrange(bool incremental=false);
 void updateZValues();
 
+// Whole canvas model (groups, boxes, ports, connections and z-order) as a binary blob.
+// Restoring needs an empty canvas and rebuilds it in one batch, without fades.
+QByteArray saveState();
+bool restoreState(const QByteArray& state);
+
 // Theme
 Theme::List getDefaultTheme();
 QString getThemeName(Theme::List id);
@@ -0,0 +1,296 @@
+/*
+ * Patchbay Canvas engine using QGraphicsView/Scene
+ * Copyright (C) 2010-2012 Filipe Coelho <falktx@falktx.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * For a full copy of the GNU General Public License see the COPYING file
+ */
+
+#include "canvasarrange.h"
+
+#include <QtCore/QList>
+#include <QtCore/QPair>
+#include <QtCore/QRectF>
+#include <QtCore/QtAlgorithms>
+
+START_NAMESPACE_PATCHCANVAS
+
+static const qreal ARRANGE_LAYER_GAP = 80;
+static const qreal ARRANGE_BOX_GAP   = 20;
+static const int   ARRANGE_SWEEPS    = 8;
+
+static bool CanvasArrangeLessThan(const QPair<qreal, int>& a, const QPair<qreal, int>& b)
+{
+    return a.first < b.first;
+}
+
+// Moves 'rect' down until it does not overlap any of 'taken'
+static QRectF CanvasArrangeFindFree(QRectF rect, const QList<QRectF>& taken)
+{
+    bool moved = true;
+    while (moved)
+    {
+        moved = false;
+        foreach (const QRectF& other, taken)
+        {
+            if (rect.intersects(other.adjusted(-ARRANGE_BOX_GAP, -ARRANGE_BOX_GAP, ARRANGE_BOX_GAP, ARRANGE_BOX_GAP)))
+            {
+                rect.moveTop(other.bottom()+ARRANGE_BOX_GAP+1);
+                moved = true;
+            }
+        }
+    }
+
+    return rect;
+}
+
+arrange_data_t CanvasArrangeLayout(arrange_data_t data)
+{
+    const int count = data.nodes.count();
+
+    if (count == 0)
+        return data;
+
+    QVector<QVector<int> > outgoing(count);
+    QVector<QVector<int> > incoming(count);
+
+    foreach (const arrange_edge_t& edge, data.edges)
+    {
+        if (edge.node_out == edge.node_in)
+            continue;
+
+        outgoing[edge.node_out].append(edge.node_in);
+        incoming[edge.node_in].append(edge.node_out);
+    }
+
+    // Topological order, feedback loops are broken at the node with the fewest unresolved inputs
+    QVector<int> order;
+    QVector<int> indegree(count);
+    QVector<bool> done(count, false);
+    QList<int> ready;
+
+    order.reserve(count);
+
+    for (int i=0; i < count; i++)
+    {
+        indegree[i] = incoming[i].count();
+        if (indegree[i] == 0)
+            ready.append(i);
+    }
+
+    while (order.count() < count)
+    {
+        if (ready.isEmpty())
+        {
+            int best = -1;
+            for (int i=0; i < count; i++)
+            {
+                if (!done[i] && (best < 0 || indegree[i] < indegree[best]))
+                    best = i;
+            }
+            indegree[best] = 0;
+            ready.append(best);
+        }
+
+        int node = ready.takeFirst();
+        if (done[node])
+            continue;
+
+        done[node] = true;
+        order.append(node);
+
+        foreach (int next, outgoing[node])
+        {
+            if (!done[next] && --indegree[next] == 0)
+                ready.append(next);
+        }
+    }
+
+    // Longest path layering, edges going back against the order are ignored
+    QVector<int> order_pos(count);
+    for (int i=0; i < count; i++)
+        order_pos[order[i]] = i;
+
+    QVector<int> layer(count, 0);
+    int max_layer = 0;
+
+    foreach (int node, order)
+    {
+        foreach (int prev, incoming[node])
+        {
+            if (order_pos[prev] < order_pos[node])
+                layer[node] = qMax(layer[node], layer[prev]+1);
+        }
+        max_layer = qMax(max_layer, layer[node]);
+    }
+
+    // Pure sinks (playback, recorders) line up on the right edge
+    for (int i=0; i < count; i++)
+    {
+        if (outgoing[i].isEmpty() && !incoming[i].isEmpty())
+            layer[i] = max_layer;
+    }
+
+    QVector<QVector<int> > layers(max_layer+1);
+    QVector<qreal> rank(count);
+
+    foreach (int node, order)
+    {
+        rank[node] = layers[layer[node]].count();
+        layers[layer[node]].append(node);
+    }
+
+    // Crossing reduction, alternating sweeps that sort each layer by the barycenter of its neighbours
+    for (int sweep=0; sweep < ARRANGE_SWEEPS && max_layer > 0; sweep++)
+    {
+        bool down = (sweep % 2 == 0);
+
+        for (int l = down ? 1 : max_layer-1; down ? l <= max_layer : l >= 0; l += down ? 1 : -1)
+        {
+            QVector<int>& nodes = layers[l];
+            QList<QPair<qreal, int> > keyed;
+
+            foreach (int node, nodes)
+            {
+                const QVector<int>& neighbours = down ? incoming[node] : outgoing[node];
+                qreal sum = 0;
+                int n = 0;
+
+                foreach (int other, neighbours)
+                {
+                    if (down ? layer[other] < l : layer[other] > l)
+                    {
+                        sum += rank[other];
+                        n++;
+                    }
+                }
+
+                keyed.append(qMakePair(n ? sum/n : rank[node], node));
+            }
+
+            qStableSort(keyed.begin(), keyed.end(), CanvasArrangeLessThan);
+
+            for (int i=0; i < keyed.count(); i++)
+            {
+                nodes[i] = keyed[i].second;
+                rank[nodes[i]] = i;
+            }
+        }
+    }
+
+    // Column positions
+    QVector<qreal> layer_x(max_layer+1);
+    QVector<qreal> layer_height(max_layer+1);
+    qreal x = data.origin.x();
+    qreal max_height = 0;
+
+    for (int l=0; l <= max_layer; l++)
+    {
+        qreal width  = 0;
+        qreal height = 0;
+
+        foreach (int node, layers[l])
+        {
+            width   = qMax(width, data.nodes[node].size.width());
+            height += data.nodes[node].size.height()+ARRANGE_BOX_GAP;
+        }
+
+        layer_x[l] = x;
+        layer_height[l] = height;
+        max_height = qMax(max_height, height);
+        x += width+ARRANGE_LAYER_GAP;
+    }
+
+    bool incremental = false;
+    for (int i=0; i < count && !incremental; i++)
+        incremental = data.nodes[i].fixed;
+
+    if (!incremental)
+    {
+        for (int l=0; l <= max_layer; l++)
+        {
+            qreal y = data.origin.y() + (max_height-layer_height[l])/2;
+
+            foreach (int node, layers[l])
+            {
+                data.nodes[node].pos = QPointF(layer_x[l], y);
+                y += data.nodes[node].size.height()+ARRANGE_BOX_GAP;
+            }
+        }
+
+        return data;
+    }
+
+    // Incremental mode, new boxes go next to their placed neighbours without moving anything else
+    QVector<bool> placed(count);
+    QList<QRectF> taken;
+
+    for (int i=0; i < count; i++)
+    {
+        placed[i] = data.nodes[i].fixed;
+        if (placed[i])
+            taken.append(QRectF(data.nodes[i].pos, data.nodes[i].size));
+    }
+
+    foreach (int node, order)
+    {
+        if (placed[node])
+            continue;
+
+        arrange_node_t& new_node = data.nodes[node];
+        qreal new_x = layer_x[layer[node]];
+        qreal new_y = data.origin.y();
+        qreal sum_y = 0;
+        int n_in = 0, n_out = 0;
+        qreal in_right = 0, out_left = 0;
+
+        foreach (int prev, incoming[node])
+        {
+            if (!placed[prev])
+                continue;
+
+            const arrange_node_t& other = data.nodes[prev];
+            in_right = n_in ? qMax(in_right, other.pos.x()+other.size.width()) : other.pos.x()+other.size.width();
+            sum_y += other.pos.y();
+            n_in++;
+        }
+
+        foreach (int next, outgoing[node])
+        {
+            if (!placed[next])
+                continue;
+
+            const arrange_node_t& other = data.nodes[next];
+            out_left = n_out ? qMin(out_left, other.pos.x()) : other.pos.x();
+            sum_y += other.pos.y();
+            n_out++;
+        }
+
+        if (n_in > 0)
+            new_x = in_right+ARRANGE_LAYER_GAP;
+        else if (n_out > 0)
+            new_x = out_left-new_node.size.width()-ARRANGE_LAYER_GAP;
+
+        if (n_in+n_out > 0)
+            new_y = sum_y/(n_in+n_out);
+
+        QRectF rect = CanvasArrangeFindFree(QRectF(QPointF(new_x, new_y), new_node.size), taken);
+
+        new_node.pos = rect.topLeft();
+        placed[node] = true;
+        taken.append(rect);
+    }
+
+    return data;
+}
+
+END_NAMESPACE_PATCHCANVAS
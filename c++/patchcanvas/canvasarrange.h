@@ -15,38 +15,40 @@
  * For a full copy of the GNU General Public License see the COPYING file
  */
 
-#ifndef CANVASFADEANIMATION_H
-#define CANVASFADEANIMATION_H
+#ifndef CANVASARRANGE_H
+#define CANVASARRANGE_H
 
-#include <QtCore/QAbstractAnimation>
+#include <QtCore/QPointF>
+#include <QtCore/QSizeF>
+#include <QtCore/QVector>
 
 #include "patchcanvas.h"
 
-class QGraphicsItem;
-
 START_NAMESPACE_PATCHCANVAS
 
-class CanvasFadeAnimation : public QAbstractAnimation
-{
-public:
-    CanvasFadeAnimation(QGraphicsItem* item, bool show, QObject* parent=0);
-
-    QGraphicsItem* item();
-    void setDuration(int time);
-
-    virtual int duration() const;
+struct arrange_node_t {
+    int group_id;
+    int box_index; // index in group_dict_t::widgets
+    QSizeF size;
+    QPointF pos;
+    bool fixed;    // keep the current position
+};
 
-protected:
-    virtual void updateCurrentTime(int time);
-    virtual void updateState(QAbstractAnimation::State newState, QAbstractAnimation::State oldState);
-    virtual void updateDirection(QAbstractAnimation::Direction direction);
+struct arrange_edge_t {
+    int node_out;
+    int node_in;
+};
 
-private:
-    bool m_show;
-    int m_duration;
-    QGraphicsItem* m_item;
+struct arrange_data_t {
+    QPointF origin;
+    QVector<arrange_node_t> nodes;
+    QVector<arrange_edge_t> edges;
 };
 
+// Layered left-to-right layout of the boxes, sources on the left and sinks on the right.
+// Only works on its own copy of the data, so it can run outside the GUI thread.
+arrange_data_t CanvasArrangeLayout(arrange_data_t data);
+
 END_NAMESPACE_PATCHCANVAS
 
-#endif // CANVASFADEANIMATION_H
+#endif // CANVASARRANGE_H
@@ -20,7 +20,6 @@
 #include <QtGui/QPainter>
 
 #include "canvasport.h"
-#include "canvasportglow.h"
 
 START_NAMESPACE_PATCHCANVAS
 
@@ -32,14 +31,22 @@ CanvasBezierLine::CanvasBezierLine(CanvasPort* item1_, CanvasPort* item2_, QGrap
 
     m_locked = false;
     m_lineSelected = false;
+    m_pos_valid = false;
 
     setBrush(QColor(0,0,0,0));
     setGraphicsEffect(0);
-    updateLinePos();
+
+    // Port positions are not final yet while batching, the line gets built at endUpdate()
+    if (canvas.update_depth > 0)
+        canvas.dirty_lines.insert(this);
+    else
+        updateLinePos();
 }
 
 CanvasBezierLine::~CanvasBezierLine()
 {
+    canvas.dirty_lines.remove(this);
+    CanvasCancelItemFX(this);
     setGraphicsEffect(0);
 }
 
@@ -69,14 +76,6 @@ void CanvasBezierLine::setLineSelected(bool yesno)
     if (m_locked)
         return;
 
-    if (options.eyecandy == EYECANDY_FULL)
-    {
-        if (yesno)
-            setGraphicsEffect(new CanvasPortGlow(item1->getPortType(), toGraphicsObject()));
-        else
-            setGraphicsEffect(0);
-    }
-
     m_lineSelected = yesno;
     updateLineGradient();
 }
@@ -91,6 +90,17 @@ void CanvasBezierLine::updateLinePos()
         int item2_x = item2->scenePos().x();
         int item2_y = item2->scenePos().y()+7.5;
 
+        // Only rebuild when one of the ends actually moved
+        QPointF item1_pos(item1_x, item1_y);
+        QPointF item2_pos(item2_x, item2_y);
+
+        if (m_pos_valid && item1_pos == m_item1_pos && item2_pos == m_item2_pos)
+            return;
+
+        m_item1_pos = item1_pos;
+        m_item2_pos = item2_pos;
+        m_pos_valid = true;
+
         int item1_mid_x = abs(item1_x-item2_x)/2;
         int item1_new_x = item1_x+item1_mid_x;
 
@@ -113,49 +123,57 @@ int CanvasBezierLine::type() const
 
 void CanvasBezierLine::updateLineGradient()
 {
-    short pos1, pos2;
-    int pos_top = boundingRect().top();
-    int pos_bot = boundingRect().bottom();
+    int pos_top = QGraphicsPathItem::boundingRect().top();
+    int pos_bot = QGraphicsPathItem::boundingRect().bottom();
+
+    PortType port_type1 = item1->getPortType();
+    PortType port_type2 = item2->getPortType();
 
+    QPen pen;
     if (item2->scenePos().y() >= item1->scenePos().y())
-    {
-        pos1 = 0;
-        pos2 = 1;
-    }
+        pen = canvas.theme->getLinePen(port_type1, port_type2, m_lineSelected);
     else
+        pen = canvas.theme->getLinePen(port_type2, port_type1, m_lineSelected);
+
+    if (pen.brush().gradient())
     {
-        pos1 = 1;
-        pos2 = 0;
+        QBrush brush(pen.brush());
+        brush.setTransform(Theme::getLineBrushTransform(pos_top, pos_bot));
+        pen.setBrush(brush);
     }
 
-    PortType port_type1 = item1->getPortType();
-    PortType port_type2 = item2->getPortType();
-    QLinearGradient port_gradient(0, pos_top, 0, pos_bot);
-
-    if (port_type1 == PORT_TYPE_AUDIO_JACK)
-        port_gradient.setColorAt(pos1, m_lineSelected ? canvas.theme->line_audio_jack_sel : canvas.theme->line_audio_jack);
-    else if (port_type1 == PORT_TYPE_MIDI_JACK)
-        port_gradient.setColorAt(pos1, m_lineSelected ? canvas.theme->line_midi_jack_sel : canvas.theme->line_midi_jack);
-    else if (port_type1 == PORT_TYPE_MIDI_A2J)
-        port_gradient.setColorAt(pos1, m_lineSelected ? canvas.theme->line_midi_a2j_sel : canvas.theme->line_midi_a2j);
-    else if (port_type1 == PORT_TYPE_MIDI_ALSA)
-        port_gradient.setColorAt(pos1, m_lineSelected ? canvas.theme->line_midi_alsa_sel : canvas.theme->line_midi_alsa);
-
-    if (port_type2 == PORT_TYPE_AUDIO_JACK)
-        port_gradient.setColorAt(pos2, m_lineSelected ? canvas.theme->line_audio_jack_sel : canvas.theme->line_audio_jack);
-    else if (port_type2 == PORT_TYPE_MIDI_JACK)
-        port_gradient.setColorAt(pos2, m_lineSelected ? canvas.theme->line_midi_jack_sel : canvas.theme->line_midi_jack);
-    else if (port_type2 == PORT_TYPE_MIDI_A2J)
-        port_gradient.setColorAt(pos2, m_lineSelected ? canvas.theme->line_midi_a2j_sel : canvas.theme->line_midi_a2j);
-    else if (port_type2 == PORT_TYPE_MIDI_ALSA)
-        port_gradient.setColorAt(pos2, m_lineSelected ? canvas.theme->line_midi_alsa_sel : canvas.theme->line_midi_alsa);
-
-    setPen(QPen(port_gradient, 2));
+    setPen(pen);
+}
+
+QRectF CanvasBezierLine::boundingRect() const
+{
+    // Leave room for the glow stroke of selected lines
+    if (options.eyecandy == EYECANDY_FULL)
+        return QGraphicsPathItem::boundingRect().adjusted(-3, -3, 3, 3);
+
+    return QGraphicsPathItem::boundingRect();
 }
 
 void CanvasBezierLine::paint(QPainter* painter, const QStyleOptionGraphicsItem* option, QWidget* widget)
 {
+    if (canvas.detail_level == DETAIL_LOW)
+    {
+        // Too small to tell curves apart, a plain segment is much cheaper
+        painter->setRenderHint(QPainter::Antialiasing, false);
+        painter->setPen(pen());
+        painter->drawLine(m_item1_pos, m_item2_pos);
+        return;
+    }
+
     painter->setRenderHint(QPainter::Antialiasing, bool(options.antialiasing));
+
+    if (m_lineSelected && options.eyecandy == EYECANDY_FULL && canvas.detail_level == DETAIL_FULL)
+    {
+        painter->setPen(canvas.theme->getLineGlowPen(item1->getPortType()));
+        painter->setBrush(Qt::NoBrush);
+        painter->drawPath(path());
+    }
+
     QGraphicsPathItem::paint(painter, option, widget);
 }
 
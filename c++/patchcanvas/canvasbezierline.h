@@ -27,7 +27,6 @@ class QPainter;
 START_NAMESPACE_PATCHCANVAS
 
 class CanvasPort;
-class CanvasPortGlow;
 
 class CanvasBezierLine :
         public AbstractCanvasLine,
@@ -58,12 +57,17 @@ public:
 private:
     CanvasPort* item1;
     CanvasPort* item2;
-    CanvasPortGlow* glow;
     bool m_locked;
     bool m_lineSelected;
 
+    // Endpoints the current geometry was built from
+    QPointF m_item1_pos;
+    QPointF m_item2_pos;
+    bool m_pos_valid;
+
     void updateLineGradient();
 
+    virtual QRectF boundingRect() const;
     virtual void paint(QPainter* painter, const QStyleOptionGraphicsItem* option, QWidget* widget);
 };
 
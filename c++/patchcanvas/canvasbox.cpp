@@ -50,7 +50,18 @@ CanvasBox::CanvasBox(int group_id, QString group_name, Icon icon, QGraphicsItem*
 
     m_cursor_moving = false;
     m_forced_split  = false;
+    m_auto_placed   = false;
     m_mouse_down    = false;
+    m_collapsed     = false;
+
+    for (int i=0; i < 3; i++)
+    {
+        for (int j=0; j < 5; j++)
+        {
+            m_summary_ports[i][j]  = 0;
+            m_summary_counts[i][j] = 0;
+        }
+    }
 
     m_port_list_ids.clear();
     m_connection_lines.clear();
@@ -59,31 +70,44 @@ CanvasBox::CanvasBox(int group_id, QString group_name, Icon icon, QGraphicsItem*
     m_font_name = QFont(canvas.theme->box_font_name, canvas.theme->box_font_size, canvas.theme->box_font_state);
     m_font_port = QFont(canvas.theme->port_font_name, canvas.theme->port_font_size, canvas.theme->port_font_state);
 
+    m_group_text.setPerformanceHint(QStaticText::AggressiveCaching);
+    m_group_text.setTextFormat(Qt::PlainText);
+    m_group_text.setText(m_group_name);
+    m_group_text.prepare(QTransform(), m_font_name);
+
     // Icon
     icon_svg = new CanvasIcon(icon, group_name, this);
 
     // Shadow
     if (options.eyecandy)
     {
-        shadow = new CanvasBoxShadow(toGraphicsObject());
-        shadow->setFakeParent(this);
-        setGraphicsEffect(shadow);
+        shadow = new CanvasBoxShadow(this);
     }
     else
         shadow = 0;
 
     // Final touches
-    setFlags(QGraphicsItem::ItemIsMovable|QGraphicsItem::ItemIsSelectable);
+    setFlags(QGraphicsItem::ItemIsMovable|QGraphicsItem::ItemIsSelectable|QGraphicsItem::ItemSendsGeometryChanges);
+
+    if (options.use_item_cache)
+        setCacheMode(QGraphicsItem::DeviceCoordinateCache);
+
+    canvas.box_grid->setBoxRect(this, sceneBoundingRect());
 
     // Wait for at least 1 port
     if (options.auto_hide_groups)
         setVisible(false);
 
-    updatePositions();
+    CanvasQueueBoxUpdate(this);
 }
 
 CanvasBox::~CanvasBox()
 {
+    canvas.dirty_boxes.remove(this);
+    canvas.box_grid->removeBox(this);
+    CanvasCancelItemFX(this);
+    CanvasRemoveFromDrag(this);
+
     if (shadow)
         delete shadow;
     delete icon_svg;
@@ -133,13 +157,69 @@ void CanvasBox::setSplit(bool split, PortMode mode)
 void CanvasBox::setGroupName(QString group_name)
 {
     m_group_name = group_name;
-    updatePositions();
+    m_group_text.setText(m_group_name);
+    m_group_text.prepare(QTransform(), m_font_name);
+    CanvasQueueBoxUpdate(this);
 }
 
-void CanvasBox::setShadowOpacity(float opacity)
+bool CanvasBox::isAutoPlaced()
 {
-    if (shadow)
-        shadow->setOpacity(opacity);
+    return m_auto_placed;
+}
+
+void CanvasBox::setAutoPlaced(bool yesno)
+{
+    m_auto_placed = yesno;
+}
+
+bool CanvasBox::isCollapsed()
+{
+    return m_collapsed;
+}
+
+void CanvasBox::setCollapsed(bool yesno)
+{
+    if (m_collapsed == yesno)
+        return;
+
+    m_collapsed = yesno;
+
+    // Lines must be off these port items already, the caller rebuilds them afterwards
+    foreach (const int& port_id, m_port_list_ids)
+    {
+        port_dict_t* port = CanvasGetPort(port_id);
+
+        if (!port)
+            continue;
+
+        if (m_collapsed)
+        {
+            delete port->widget;
+            port->widget = 0;
+            m_summary_counts[port->port_mode][port->port_type] += 1;
+        }
+        else
+            port->widget = new CanvasPort(port_id, port->port_name, port->port_mode, port->port_type, this);
+    }
+
+    // Summary names are only built once per mode and type
+    for (int i=PORT_MODE_INPUT; i <= PORT_MODE_OUTPUT; i++)
+    {
+        for (int j=PORT_TYPE_AUDIO_JACK; j <= PORT_TYPE_MIDI_ALSA; j++)
+        {
+            if (!m_collapsed)
+                m_summary_counts[i][j] = 0;
+
+            updateSummaryPort(static_cast<PortMode>(i), static_cast<PortType>(j));
+        }
+    }
+
+    CanvasQueueBoxUpdate(this);
+}
+
+CanvasPort* CanvasBox::getSummaryPort(PortMode port_mode, PortType port_type)
+{
+    return m_summary_ports[port_mode][port_type];
 }
 
 CanvasPort* CanvasBox::addPortFromGroup(int port_id, QString port_name, PortMode port_mode, PortType port_type)
@@ -154,6 +234,13 @@ CanvasPort* CanvasBox::addPortFromGroup(int port_id, QString port_name, PortMode
         }
     }
 
+    if (m_collapsed)
+    {
+        m_port_list_ids.append(port_id);
+        addToSummary(port_mode, port_type);
+        return 0;
+    }
+
     CanvasPort* new_widget = new CanvasPort(port_id, port_name, port_mode, port_type, this);
 
     port_dict_t port_dict;
@@ -174,6 +261,12 @@ void CanvasBox::removePortFromGroup(int port_id)
     if (m_port_list_ids.contains(port_id))
     {
         m_port_list_ids.removeOne(port_id);
+
+        if (m_collapsed)
+        {
+            if (const port_dict_t* port = CanvasGetPort(port_id))
+                removeFromSummary(port->port_mode, port->port_type);
+        }
     }
     else
     {
@@ -183,7 +276,7 @@ void CanvasBox::removePortFromGroup(int port_id)
 
     if (m_port_list_ids.count() > 0)
     {
-        updatePositions();
+        CanvasQueueBoxUpdate(this);
     }
     else if (isVisible())
     {
@@ -197,6 +290,29 @@ void CanvasBox::removePortFromGroup(int port_id)
     }
 }
 
+void CanvasBox::attachPort(const port_dict_t* port)
+{
+    if (m_port_list_ids.count() == 0)
+    {
+        if (options.auto_hide_groups)
+        {
+            if (options.eyecandy == EYECANDY_FULL)
+                CanvasItemFX(this, true);
+            setVisible(true);
+        }
+    }
+
+    // The port keeps its item, only its parent box changes
+    if (port->widget)
+        port->widget->setParentItem(this);
+    else if (m_collapsed)
+        addToSummary(port->port_mode, port->port_type);
+
+    m_port_list_ids.append(port->port_id);
+
+    CanvasQueueBoxUpdate(this);
+}
+
 void CanvasBox::addLineFromGroup(AbstractCanvasLine* line, int connection_id)
 {
     cb_line_t new_cbline;
@@ -262,74 +378,103 @@ void CanvasBox::updatePositions()
     p_height = 25;
 
     // Check Text Name size
-    int app_name_size = QFontMetrics(m_font_name).width(m_group_name)+30;
+    int app_name_size = canvas.theme->getTextWidth(m_font_name, m_group_name)+30;
     if (app_name_size > p_width)
         p_width = app_name_size;
 
-    // Get Port List
-    QList<port_dict_t> port_list;
-    foreach (const port_dict_t& port, canvas.port_list)
+    // Get Port List, in the order they were added to this box
+    QList<const port_dict_t*> port_list;
+    QList<port_dict_t> summary_list;
+
+    if (m_collapsed)
     {
-        if (m_port_list_ids.contains(port.port_id))
-            port_list.append(port);
+        // Lay out the summary ports the same way as regular ones
+        for (int i=PORT_MODE_INPUT; i <= PORT_MODE_OUTPUT; i++)
+        {
+            for (int j=PORT_TYPE_AUDIO_JACK; j <= PORT_TYPE_MIDI_ALSA; j++)
+            {
+                if (CanvasPort* summary_port = m_summary_ports[i][j])
+                {
+                    port_dict_t port_dict;
+                    port_dict.group_id  = m_group_id;
+                    port_dict.port_id   = -1;
+                    port_dict.port_name = summary_port->getPortName();
+                    port_dict.port_mode = static_cast<PortMode>(i);
+                    port_dict.port_type = static_cast<PortType>(j);
+                    port_dict.widget    = summary_port;
+                    summary_list.append(port_dict);
+                }
+            }
+        }
+
+        for (int i=0; i < summary_list.count(); i++)
+            port_list.append(&summary_list.at(i));
+    }
+    else
+    {
+        foreach (const int& port_id, m_port_list_ids)
+        {
+            if (const port_dict_t* port = CanvasGetPort(port_id))
+                port_list.append(port);
+        }
     }
 
     // Get Max Box Width/Height
-    foreach (const port_dict_t& port, port_list)
+    foreach (const port_dict_t* port, port_list)
     {
-        if (port.port_mode == PORT_MODE_INPUT)
+        if (port->port_mode == PORT_MODE_INPUT)
         {
             max_in_height += 18;
 
-            int size = QFontMetrics(m_font_port).width(port.port_name);
+            int size = canvas.theme->getTextWidth(m_font_port, port->port_name);
             if (size > max_in_width)
                 max_in_width = size;
 
-            if (port.port_type == PORT_TYPE_AUDIO_JACK && have_audio_jack_in == false)
+            if (port->port_type == PORT_TYPE_AUDIO_JACK && have_audio_jack_in == false)
             {
                 have_audio_jack_in = true;
                 max_in_height += 2;
             }
-            else if (port.port_type == PORT_TYPE_MIDI_JACK && have_midi_jack_in == false)
+            else if (port->port_type == PORT_TYPE_MIDI_JACK && have_midi_jack_in == false)
             {
                 have_midi_jack_in = true;
                 max_in_height += 2;
             }
-            else if (port.port_type == PORT_TYPE_MIDI_A2J && have_midi_a2j_in == false)
+            else if (port->port_type == PORT_TYPE_MIDI_A2J && have_midi_a2j_in == false)
             {
                 have_midi_a2j_in = true;
                 max_in_height += 2;
             }
-            else if (port.port_type == PORT_TYPE_MIDI_ALSA && have_midi_alsa_in == false)
+            else if (port->port_type == PORT_TYPE_MIDI_ALSA && have_midi_alsa_in == false)
             {
                 have_midi_alsa_in = true;
                 max_in_height += 2;
             }
         }
-        else if (port.port_mode == PORT_MODE_OUTPUT)
+        else if (port->port_mode == PORT_MODE_OUTPUT)
         {
             max_out_height += 18;
 
-            int size = QFontMetrics(m_font_port).width(port.port_name);
+            int size = canvas.theme->getTextWidth(m_font_port, port->port_name);
             if (size > max_out_width)
                 max_out_width = size;
 
-            if (port.port_type == PORT_TYPE_AUDIO_JACK && have_audio_jack_out == false)
+            if (port->port_type == PORT_TYPE_AUDIO_JACK && have_audio_jack_out == false)
             {
                 have_audio_jack_out = true;
                 max_out_height += 2;
             }
-            else if (port.port_type == PORT_TYPE_MIDI_JACK && have_midi_jack_out == false)
+            else if (port->port_type == PORT_TYPE_MIDI_JACK && have_midi_jack_out == false)
             {
                 have_midi_jack_out = true;
                 max_out_height += 2;
             }
-            else if (port.port_type == PORT_TYPE_MIDI_A2J && have_midi_a2j_out == false)
+            else if (port->port_type == PORT_TYPE_MIDI_A2J && have_midi_a2j_out == false)
             {
                 have_midi_a2j_out = true;
                 max_out_height += 2;
             }
-            else if (port.port_type == PORT_TYPE_MIDI_ALSA && have_midi_alsa_out == false)
+            else if (port->port_type == PORT_TYPE_MIDI_ALSA && have_midi_alsa_out == false)
             {
                 have_midi_alsa_out = true;
                 max_out_height += 2;
@@ -356,119 +501,124 @@ void CanvasBox::updatePositions()
     PortType last_out_type = PORT_TYPE_NULL;
 
     // Re-position ports, AUDIO_JACK
-    foreach (const port_dict_t& port, port_list)
+    foreach (const port_dict_t* port, port_list)
     {
-        if (port.port_type == PORT_TYPE_AUDIO_JACK)
+        if (port->port_type == PORT_TYPE_AUDIO_JACK)
         {
-            if (port.port_mode == PORT_MODE_INPUT)
+            if (port->port_mode == PORT_MODE_INPUT)
             {
-                port.widget->setPos(QPointF(1, last_in_pos));
-                port.widget->setPortWidth(max_in_width);
+                port->widget->setPos(QPointF(1, last_in_pos));
+                port->widget->setPortWidth(max_in_width);
 
                 last_in_pos += 18;
-                last_in_type = port.port_type;
+                last_in_type = port->port_type;
             }
-            else if (port.port_mode == PORT_MODE_OUTPUT)
+            else if (port->port_mode == PORT_MODE_OUTPUT)
             {
-                port.widget->setPos(QPointF(p_width-max_out_width-13, last_out_pos));
-                port.widget->setPortWidth(max_out_width);
+                port->widget->setPos(QPointF(p_width-max_out_width-13, last_out_pos));
+                port->widget->setPortWidth(max_out_width);
 
                 last_out_pos += 18;
-                last_out_type = port.port_type;
+                last_out_type = port->port_type;
             }
         }
     }
 
     // Re-position ports, MIDI_JACK
-    foreach (const port_dict_t& port, port_list)
+    foreach (const port_dict_t* port, port_list)
     {
-        if (port.port_type == PORT_TYPE_MIDI_JACK)
+        if (port->port_type == PORT_TYPE_MIDI_JACK)
         {
-            if (port.port_mode == PORT_MODE_INPUT)
+            if (port->port_mode == PORT_MODE_INPUT)
             {
-                if (last_in_type != PORT_TYPE_NULL && port.port_type != last_in_type)
+                if (last_in_type != PORT_TYPE_NULL && port->port_type != last_in_type)
                     last_in_pos += 2;
 
-                port.widget->setPos(QPointF(1, last_in_pos));
-                port.widget->setPortWidth(max_in_width);
+                port->widget->setPos(QPointF(1, last_in_pos));
+                port->widget->setPortWidth(max_in_width);
 
                 last_in_pos += 18;
-                last_in_type = port.port_type;
+                last_in_type = port->port_type;
             }
-            else if (port.port_mode == PORT_MODE_OUTPUT)
+            else if (port->port_mode == PORT_MODE_OUTPUT)
             {
-                if (last_out_type != PORT_TYPE_NULL && port.port_type != last_out_type)
+                if (last_out_type != PORT_TYPE_NULL && port->port_type != last_out_type)
                     last_out_pos += 2;
 
-                port.widget->setPos(QPointF(p_width-max_out_width-13, last_out_pos));
-                port.widget->setPortWidth(max_out_width);
+                port->widget->setPos(QPointF(p_width-max_out_width-13, last_out_pos));
+                port->widget->setPortWidth(max_out_width);
 
                 last_out_pos += 18;
-                last_out_type = port.port_type;
+                last_out_type = port->port_type;
             }
         }
     }
 
     // Re-position ports, MIDI_A2J
-    foreach (const port_dict_t& port, port_list)
+    foreach (const port_dict_t* port, port_list)
     {
-        if (port.port_type == PORT_TYPE_MIDI_A2J)
+        if (port->port_type == PORT_TYPE_MIDI_A2J)
         {
-            if (port.port_mode == PORT_MODE_INPUT)
+            if (port->port_mode == PORT_MODE_INPUT)
             {
-                if (last_in_type != PORT_TYPE_NULL && port.port_type != last_in_type)
+                if (last_in_type != PORT_TYPE_NULL && port->port_type != last_in_type)
                     last_in_pos += 2;
 
-                port.widget->setPos(QPointF(1, last_in_pos));
-                port.widget->setPortWidth(max_in_width);
+                port->widget->setPos(QPointF(1, last_in_pos));
+                port->widget->setPortWidth(max_in_width);
 
                 last_in_pos += 18;
-                last_in_type = port.port_type;
+                last_in_type = port->port_type;
             }
-            else if (port.port_mode == PORT_MODE_OUTPUT)
+            else if (port->port_mode == PORT_MODE_OUTPUT)
             {
-                if (last_out_type != PORT_TYPE_NULL && port.port_type != last_out_type)
+                if (last_out_type != PORT_TYPE_NULL && port->port_type != last_out_type)
                     last_out_pos += 2;
 
-                port.widget->setPos(QPointF(p_width-max_out_width-13, last_out_pos));
-                port.widget->setPortWidth(max_out_width);
+                port->widget->setPos(QPointF(p_width-max_out_width-13, last_out_pos));
+                port->widget->setPortWidth(max_out_width);
 
                 last_out_pos += 18;
-                last_out_type = port.port_type;
+                last_out_type = port->port_type;
             }
         }
     }
 
     // Re-position ports, MIDI_ALSA
-    foreach (const port_dict_t& port, port_list)
+    foreach (const port_dict_t* port, port_list)
     {
-        if (port.port_type == PORT_TYPE_MIDI_ALSA)
+        if (port->port_type == PORT_TYPE_MIDI_ALSA)
         {
-            if (port.port_mode == PORT_MODE_INPUT)
+            if (port->port_mode == PORT_MODE_INPUT)
             {
-                if (last_in_type != PORT_TYPE_NULL && port.port_type != last_in_type)
+                if (last_in_type != PORT_TYPE_NULL && port->port_type != last_in_type)
                     last_in_pos += 2;
 
-                port.widget->setPos(QPointF(1, last_in_pos));
-                port.widget->setPortWidth(max_in_width);
+                port->widget->setPos(QPointF(1, last_in_pos));
+                port->widget->setPortWidth(max_in_width);
 
                 last_in_pos += 18;
-                last_in_type = port.port_type;
+                last_in_type = port->port_type;
             }
-            else if (port.port_mode == PORT_MODE_OUTPUT)
+            else if (port->port_mode == PORT_MODE_OUTPUT)
             {
-                if (last_out_type != PORT_TYPE_NULL && port.port_type != last_out_type)
+                if (last_out_type != PORT_TYPE_NULL && port->port_type != last_out_type)
                     last_out_pos += 2;
 
-                port.widget->setPos(QPointF(p_width-max_out_width-13, last_out_pos));
-                port.widget->setPortWidth(max_out_width);
+                port->widget->setPos(QPointF(p_width-max_out_width-13, last_out_pos));
+                port->widget->setPortWidth(max_out_width);
 
                 last_out_pos += 18;
-                last_out_type = port.port_type;
+                last_out_type = port->port_type;
             }
         }
     }
 
+    canvas.box_grid->setBoxRect(this, sceneBoundingRect());
+
+    if (shadow)
+        shadow->setBoxRect(QRectF(0, 0, p_width, p_height));
+
     repaintLines(true);
     update();
 }
@@ -478,7 +628,12 @@ void CanvasBox::repaintLines(bool forced)
     if (pos() != m_last_pos || forced)
     {
         foreach (const cb_line_t& connection, m_connection_lines)
-            connection.line->updateLinePos();
+        {
+            if (canvas.update_depth > 0)
+                canvas.dirty_lines.insert(connection.line);
+            else
+                connection.line->updateLinePos();
+        }
     }
 
     m_last_pos = pos();
@@ -486,15 +641,69 @@ void CanvasBox::repaintLines(bool forced)
 
 void CanvasBox::resetLinesZValue()
 {
-    foreach (const connection_dict_t& connection, canvas.connection_list)
+    foreach (const cb_line_t& cb_line, m_connection_lines)
     {
+        const connection_dict_t* connection = CanvasGetConnection(cb_line.connection_id);
+        if (!connection)
+            continue;
+
+        const port_dict_t* port_out = CanvasGetPort(connection->port_out_id);
+        const port_dict_t* port_in  = CanvasGetPort(connection->port_in_id);
+
         int z_value;
-        if (m_port_list_ids.contains(connection.port_out_id) && m_port_list_ids.contains(connection.port_in_id))
+        if (port_out && port_in && CanvasGetPortItem(port_out)->parentItem() == this && CanvasGetPortItem(port_in)->parentItem() == this)
             z_value = canvas.last_z_value;
         else
             z_value = canvas.last_z_value-1;
 
-        connection.widget->setZValue(z_value);
+        cb_line.line->setZValue(z_value);
+    }
+}
+
+void CanvasBox::addToSummary(PortMode port_mode, PortType port_type)
+{
+    m_summary_counts[port_mode][port_type] += 1;
+    updateSummaryPort(port_mode, port_type);
+}
+
+void CanvasBox::removeFromSummary(PortMode port_mode, PortType port_type)
+{
+    if (m_summary_counts[port_mode][port_type] == 0)
+        return;
+
+    m_summary_counts[port_mode][port_type] -= 1;
+    updateSummaryPort(port_mode, port_type);
+}
+
+void CanvasBox::updateSummaryPort(PortMode port_mode, PortType port_type)
+{
+    int count = m_summary_counts[port_mode][port_type];
+    CanvasPort*& summary_port = m_summary_ports[port_mode][port_type];
+
+    if (count == 0)
+    {
+        delete summary_port;
+        summary_port = 0;
+    }
+    else
+    {
+        QString type_name;
+        if (port_type == PORT_TYPE_AUDIO_JACK)
+            type_name = "audio";
+        else if (port_type == PORT_TYPE_MIDI_JACK)
+            type_name = "midi";
+        else if (port_type == PORT_TYPE_MIDI_A2J)
+            type_name = "a2j midi";
+        else
+            type_name = "alsa midi";
+
+        // Shown as "32 audio in"
+        QString summary_name = QString("%1 %2 %3").arg(count).arg(type_name).arg(port_mode == PORT_MODE_INPUT ? "in" : "out");
+
+        if (summary_port)
+            summary_port->setPortName(summary_name);
+        else
+            summary_port = new CanvasPort(-1, summary_name, port_mode, port_type, this);
     }
 }
 
@@ -547,6 +756,7 @@ void CanvasBox::contextMenuEvent(QGraphicsSceneContextMenuEvent* event)
     QAction* act_x_rename     = menu.addAction("&Rename");
     QAction* act_x_sep2       = menu.addSeparator();
     QAction* act_x_split_join = menu.addAction(m_splitted ? "Join" : "Split");
+    QAction* act_x_collapse   = menu.addAction(m_collapsed ? "&Expand" : "&Collapse");
 
     if (features.group_info == false)
         act_x_info->setVisible(false);
@@ -559,13 +769,13 @@ void CanvasBox::contextMenuEvent(QGraphicsSceneContextMenuEvent* event)
 
     bool haveIns, haveOuts;
     haveIns = haveOuts = false;
-    foreach (const port_dict_t& port, canvas.port_list)
+    foreach (const int& port_id, m_port_list_ids)
     {
-        if (m_port_list_ids.contains(port.port_id))
+        if (const port_dict_t* port = CanvasGetPort(port_id))
         {
-            if (port.port_mode == PORT_MODE_INPUT)
+            if (port->port_mode == PORT_MODE_INPUT)
                 haveIns = true;
-            else if (port.port_mode == PORT_MODE_OUTPUT)
+            else if (port->port_mode == PORT_MODE_OUTPUT)
                 haveOuts = true;
         }
     }
@@ -604,6 +814,11 @@ void CanvasBox::contextMenuEvent(QGraphicsSceneContextMenuEvent* event)
             canvas.callback(ACTION_GROUP_SPLIT, m_group_id, 0, "");
 
     }
+    else if (act_selected == act_x_collapse)
+    {
+        // Only changes how the group is shown, nothing for the host to do
+        setGroupCollapsed(m_group_id, !m_collapsed);
+    }
 
     event->accept();
 }
@@ -647,8 +862,12 @@ void CanvasBox::mouseMoveEvent(QGraphicsSceneMouseEvent* event)
         {
             setCursor(QCursor(Qt::SizeAllCursor));
             m_cursor_moving = true;
+            CanvasBeginDrag(this, event->buttonDownScenePos(Qt::LeftButton));
         }
-        repaintLines();
+
+        // The move itself is applied once per frame
+        CanvasUpdateDrag(event->scenePos());
+        return event->accept();
     }
     QGraphicsItem::mouseMoveEvent(event);
 }
@@ -656,12 +875,36 @@ void CanvasBox::mouseMoveEvent(QGraphicsSceneMouseEvent* event)
 void CanvasBox::mouseReleaseEvent(QGraphicsSceneMouseEvent* event)
 {
     if (m_cursor_moving)
+    {
+        CanvasEndDrag();
         setCursor(QCursor(Qt::ArrowCursor));
+        m_auto_placed = false;
+    }
     m_mouse_down = false;
     m_cursor_moving = false;
     QGraphicsItem::mouseReleaseEvent(event);
 }
 
+QVariant CanvasBox::itemChange(GraphicsItemChange change, const QVariant& value)
+{
+    // Keep the attached lines in sync whenever the box moves
+    if (change == QGraphicsItem::ItemPositionHasChanged)
+    {
+        canvas.box_grid->setBoxRect(this, sceneBoundingRect());
+        repaintLines();
+    }
+    else if (change == QGraphicsItem::ItemVisibleHasChanged)
+    {
+        canvas.box_grid->setBoxShown(this, value.toBool());
+    }
+    else if (change == QGraphicsItem::ItemZValueHasChanged && canvas.line_layer)
+    {
+        canvas.line_layer->boxZValueChanged(value.toReal());
+    }
+
+    return QGraphicsItem::itemChange(change, value);
+}
+
 QRectF CanvasBox::boundingRect() const
 {
     return QRectF(0, 0, p_width, p_height);
@@ -671,6 +914,12 @@ void CanvasBox::paint(QPainter* painter, const QStyleOptionGraphicsItem* /*optio
 {
     painter->setRenderHint(QPainter::Antialiasing, false);
 
+    if (canvas.detail_level == DETAIL_LOW)
+    {
+        painter->fillRect(QRectF(0, 0, p_width, p_height), isSelected() ? canvas.theme->box_pen_sel.color() : canvas.theme->box_bg_1);
+        return;
+    }
+
     if (isSelected())
         painter->setPen(canvas.theme->box_pen_sel);
     else
@@ -683,13 +932,12 @@ void CanvasBox::paint(QPainter* painter, const QStyleOptionGraphicsItem* /*optio
     painter->setBrush(box_gradient);
     painter->drawRect(0, 0, p_width, p_height);
 
-    QPointF text_pos(25, 16);
+    // Static text is positioned by its top-left corner, not the baseline
+    QPointF text_pos(25, 16-canvas.theme->getTextAscent(m_font_name));
 
     painter->setFont(m_font_name);
     painter->setPen(canvas.theme->box_text);
-    painter->drawText(text_pos, m_group_name);
-
-    repaintLines();
+    painter->drawStaticText(text_pos, m_group_text);
 }
 
 END_NAMESPACE_PATCHCANVAS
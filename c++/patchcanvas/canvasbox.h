@@ -18,6 +18,8 @@
 #ifndef CANVASBOX_H
 #define CANVASBOX_H
 
+#include <QtGui/QStaticText>
+
 #include "patchcanvas.h"
 
 class QGraphicsSceneContextMenuEvent;
@@ -54,10 +56,16 @@ public:
     void setSplit(bool split, PortMode mode=PORT_MODE_NULL);
     void setGroupName(QString group_name);
 
-    void setShadowOpacity(float opacity);
+    bool isAutoPlaced();
+    void setAutoPlaced(bool yesno);
+
+    bool isCollapsed();
+    void setCollapsed(bool yesno);
+    CanvasPort* getSummaryPort(PortMode port_mode, PortType port_type);
 
     CanvasPort* addPortFromGroup(int port_id, QString port_name, PortMode port_mode, PortType port_type);
     void removePortFromGroup(int port_id);
+    void attachPort(const port_dict_t* port);
     void addLineFromGroup(AbstractCanvasLine* line, int connection_id);
     void removeLineFromGroup(int connection_id);
 
@@ -85,20 +93,33 @@ private:
     PortMode m_splitted_mode;
 
     bool m_forced_split;
+    bool m_auto_placed;
+
+    // One summary port per port mode and type while collapsed
+    bool m_collapsed;
+    CanvasPort* m_summary_ports[3][5];
+    int m_summary_counts[3][5];
     bool m_cursor_moving;
     bool m_mouse_down;
 
     QFont m_font_name;
     QFont m_font_port;
+    QStaticText m_group_text;
 
     CanvasIcon* icon_svg;
     CanvasBoxShadow* shadow;
 
+    void addToSummary(PortMode port_mode, PortType port_type);
+    void removeFromSummary(PortMode port_mode, PortType port_type);
+    void updateSummaryPort(PortMode port_mode, PortType port_type);
+
     virtual void contextMenuEvent(QGraphicsSceneContextMenuEvent* event);
     virtual void mousePressEvent(QGraphicsSceneMouseEvent* event);
     virtual void mouseMoveEvent(QGraphicsSceneMouseEvent* event);
     virtual void mouseReleaseEvent(QGraphicsSceneMouseEvent* event);
 
+    virtual QVariant itemChange(GraphicsItemChange change, const QVariant& value);
+
     virtual QRectF boundingRect() const;
     virtual void paint(QPainter* painter, const QStyleOptionGraphicsItem* option, QWidget* widget);
 };
@@ -0,0 +1,217 @@
+/*
+ * Patchbay Canvas engine using QGraphicsView/Scene
+ * Copyright (C) 2010-2012 Filipe Coelho <falktx@falktx.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * For a full copy of the GNU General Public License see the COPYING file
+ */
+
+#include "canvasboxgrid.h"
+
+#include <cmath>
+
+START_NAMESPACE_PATCHCANVAS
+
+CanvasBoxGrid::CanvasBoxGrid(qreal cell_size)
+{
+    m_cell_size = cell_size;
+    m_bounds_dirty = false;
+}
+
+void CanvasBoxGrid::setBoxRect(CanvasBox* box, const QRectF& rect)
+{
+    QHash<CanvasBox*, QRectF>::iterator it = m_rects.find(box);
+
+    if (it != m_rects.end())
+    {
+        if (it.value() == rect)
+            return;
+
+        removeFromCells(box, it.value());
+        invalidateBounds(it.value());
+        it.value() = rect;
+    }
+    else
+        m_rects.insert(box, rect);
+
+    addToCells(box, rect);
+
+    if (!m_bounds_dirty && !m_hidden.contains(box))
+        m_bounds = m_bounds.isNull() ? rect : m_bounds.united(rect);
+}
+
+void CanvasBoxGrid::removeBox(CanvasBox* box)
+{
+    QHash<CanvasBox*, QRectF>::iterator it = m_rects.find(box);
+
+    if (it == m_rects.end())
+        return;
+
+    removeFromCells(box, it.value());
+    invalidateBounds(it.value());
+    m_rects.erase(it);
+    m_hidden.remove(box);
+}
+
+void CanvasBoxGrid::setBoxShown(CanvasBox* box, bool shown)
+{
+    if (shown == !m_hidden.contains(box))
+        return;
+
+    QHash<CanvasBox*, QRectF>::const_iterator it = m_rects.constFind(box);
+
+    if (shown)
+    {
+        m_hidden.remove(box);
+
+        if (it != m_rects.constEnd() && !m_bounds_dirty)
+            m_bounds = m_bounds.isNull() ? it.value() : m_bounds.united(it.value());
+    }
+    else
+    {
+        m_hidden.insert(box);
+
+        if (it != m_rects.constEnd())
+            invalidateBounds(it.value());
+    }
+}
+
+void CanvasBoxGrid::clear()
+{
+    m_cells.clear();
+    m_rects.clear();
+    m_hidden.clear();
+    m_bounds = QRectF();
+    m_bounds_dirty = false;
+}
+
+CanvasBox* CanvasBoxGrid::boxAt(const QPointF& pos) const
+{
+    QHash<quint64, QList<CanvasBox*> >::const_iterator cell = m_cells.find(cellKey(cellCoord(pos.x()), cellCoord(pos.y())));
+
+    if (cell == m_cells.end())
+        return 0;
+
+    foreach (CanvasBox* box, cell.value())
+    {
+        if (m_rects.value(box).contains(pos))
+            return box;
+    }
+
+    return 0;
+}
+
+QList<CanvasBox*> CanvasBoxGrid::boxesIn(const QRectF& rect) const
+{
+    QList<CanvasBox*> boxes;
+
+    int x1 = cellCoord(rect.left());
+    int x2 = cellCoord(rect.right());
+    int y1 = cellCoord(rect.top());
+    int y2 = cellCoord(rect.bottom());
+
+    for (int x=x1; x <= x2; x++)
+    {
+        for (int y=y1; y <= y2; y++)
+        {
+            QHash<quint64, QList<CanvasBox*> >::const_iterator cell = m_cells.find(cellKey(x, y));
+
+            if (cell == m_cells.end())
+                continue;
+
+            foreach (CanvasBox* box, cell.value())
+            {
+                // Boxes spanning several cells are reported once
+                if (!boxes.contains(box) && m_rects.value(box).intersects(rect))
+                    boxes.append(box);
+            }
+        }
+    }
+
+    return boxes;
+}
+
+QRectF CanvasBoxGrid::boundingRect() const
+{
+    if (m_bounds_dirty)
+    {
+        m_bounds = QRectF();
+
+        for (QHash<CanvasBox*, QRectF>::const_iterator it = m_rects.constBegin(); it != m_rects.constEnd(); ++it)
+        {
+            if (!m_hidden.contains(it.key()))
+                m_bounds = m_bounds.isNull() ? it.value() : m_bounds.united(it.value());
+        }
+
+        m_bounds_dirty = false;
+    }
+
+    return m_bounds;
+}
+
+void CanvasBoxGrid::invalidateBounds(const QRectF& old_rect)
+{
+    // Only a rect touching the edge can make the bounds shrink
+    if (old_rect.left() <= m_bounds.left() || old_rect.top() <= m_bounds.top() ||
+        old_rect.right() >= m_bounds.right() || old_rect.bottom() >= m_bounds.bottom())
+        m_bounds_dirty = true;
+}
+
+quint64 CanvasBoxGrid::cellKey(int x, int y) const
+{
+    return (quint64(quint32(x)) << 32) | quint32(y);
+}
+
+int CanvasBoxGrid::cellCoord(qreal value) const
+{
+    return int(std::floor(value/m_cell_size));
+}
+
+void CanvasBoxGrid::addToCells(CanvasBox* box, const QRectF& rect)
+{
+    int x1 = cellCoord(rect.left());
+    int x2 = cellCoord(rect.right());
+    int y1 = cellCoord(rect.top());
+    int y2 = cellCoord(rect.bottom());
+
+    for (int x=x1; x <= x2; x++)
+    {
+        for (int y=y1; y <= y2; y++)
+            m_cells[cellKey(x, y)].append(box);
+    }
+}
+
+void CanvasBoxGrid::removeFromCells(CanvasBox* box, const QRectF& rect)
+{
+    int x1 = cellCoord(rect.left());
+    int x2 = cellCoord(rect.right());
+    int y1 = cellCoord(rect.top());
+    int y2 = cellCoord(rect.bottom());
+
+    for (int x=x1; x <= x2; x++)
+    {
+        for (int y=y1; y <= y2; y++)
+        {
+            QHash<quint64, QList<CanvasBox*> >::iterator cell = m_cells.find(cellKey(x, y));
+
+            if (cell == m_cells.end())
+                continue;
+
+            cell.value().removeOne(box);
+
+            if (cell.value().isEmpty())
+                m_cells.erase(cell);
+        }
+    }
+}
+
+END_NAMESPACE_PATCHCANVAS
@@ -0,0 +1,72 @@
+/*
+ * Patchbay Canvas engine using QGraphicsView/Scene
+ * Copyright (C) 2010-2012 Filipe Coelho <falktx@falktx.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * For a full copy of the GNU General Public License see the COPYING file
+ */
+
+#ifndef CANVASBOXGRID_H
+#define CANVASBOXGRID_H
+
+#include <QtCore/QHash>
+#include <QtCore/QList>
+#include <QtCore/QRectF>
+#include <QtCore/QSet>
+
+#include "patchcanvas.h"
+
+START_NAMESPACE_PATCHCANVAS
+
+class CanvasBox;
+
+// Uniform grid over the scene rects of all boxes
+class CanvasBoxGrid
+{
+public:
+    CanvasBoxGrid(qreal cell_size=128);
+
+    void setBoxRect(CanvasBox* box, const QRectF& rect);
+    void removeBox(CanvasBox* box);
+
+    // Hidden boxes and boxes fading out stay in the cells but are left out of the bounds
+    void setBoxShown(CanvasBox* box, bool shown);
+    void clear();
+
+    CanvasBox* boxAt(const QPointF& pos) const;
+    QList<CanvasBox*> boxesIn(const QRectF& rect) const;
+
+    // Union of the rects of all shown boxes
+    QRectF boundingRect() const;
+
+private:
+    qreal m_cell_size;
+    QHash<quint64, QList<CanvasBox*> > m_cells;
+    QHash<CanvasBox*, QRectF> m_rects;
+    QSet<CanvasBox*> m_hidden;
+
+    // Grows as boxes are added, recomputed only after a box on its edge moved away
+    mutable QRectF m_bounds;
+    mutable bool m_bounds_dirty;
+
+    quint64 cellKey(int x, int y) const;
+    int cellCoord(qreal value) const;
+
+    void invalidateBounds(const QRectF& old_rect);
+
+    void addToCells(CanvasBox* box, const QRectF& rect);
+    void removeFromCells(CanvasBox* box, const QRectF& rect);
+};
+
+END_NAMESPACE_PATCHCANVAS
+
+#endif // CANVASBOXGRID_H
@@ -17,37 +17,42 @@
 
 #include "canvasboxshadow.h"
 
-#include "canvasbox.h"
+#include <QtGui/QDrawUtil>
+#include <QtGui/QPainter>
 
 START_NAMESPACE_PATCHCANVAS
 
-CanvasBoxShadow::CanvasBoxShadow(QObject* parent) :
-    QGraphicsDropShadowEffect(parent)
+CanvasBoxShadow::CanvasBoxShadow(QGraphicsItem* parent) :
+    QGraphicsItem(parent)
 {
-    m_fakeParent = 0;
+    m_box_rect = QRectF(0, 0, 0, 0);
 
-    setBlurRadius(20);
-    setColor(canvas.theme->box_shadow);
-    setOffset(0, 0);
+    setFlag(QGraphicsItem::ItemStacksBehindParent);
+    setAcceptedMouseButtons(Qt::NoButton);
 }
 
-void CanvasBoxShadow::setFakeParent(CanvasBox* fakeParent)
+void CanvasBoxShadow::setBoxRect(const QRectF& rect)
 {
-    m_fakeParent = fakeParent;
+    if (rect == m_box_rect)
+        return;
+
+    prepareGeometryChange();
+    m_box_rect = rect;
 }
 
-void CanvasBoxShadow::setOpacity(float opacity)
+QRectF CanvasBoxShadow::boundingRect() const
 {
-        QColor color(canvas.theme->box_shadow);
-        color.setAlphaF(opacity);
-        setColor(color);
+    int radius = canvas.theme->getBoxShadowRadius();
+    return m_box_rect.adjusted(-radius, -radius, radius, radius);
 }
 
-void CanvasBoxShadow::draw(QPainter* painter)
+void CanvasBoxShadow::paint(QPainter* painter, const QStyleOptionGraphicsItem* /*option*/, QWidget* /*widget*/)
 {
-    if (m_fakeParent)
-        m_fakeParent->repaintLines();
-    QGraphicsDropShadowEffect::draw(painter);
+    if (canvas.detail_level != DETAIL_FULL || m_box_rect.isEmpty())
+        return;
+
+    int radius = canvas.theme->getBoxShadowRadius();
+    qDrawBorderPixmap(painter, boundingRect().toRect(), QMargins(radius, radius, radius, radius), canvas.theme->getBoxShadowPixmap());
 }
 
 END_NAMESPACE_PATCHCANVAS
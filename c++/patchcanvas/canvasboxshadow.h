@@ -18,26 +18,27 @@
 #ifndef CANVASBOXSHADOW_H
 #define CANVASBOXSHADOW_H
 
-#include <QGraphicsDropShadowEffect>
+#include <QtGui/QGraphicsItem>
 
 #include "patchcanvas.h"
 
-START_NAMESPACE_PATCHCANVAS
+class QPainter;
 
-class CanvasBox;
+START_NAMESPACE_PATCHCANVAS
 
-class CanvasBoxShadow : public QGraphicsDropShadowEffect
+// Soft shadow behind a box, drawn from the theme's nine-slice pixmap
+class CanvasBoxShadow : public QGraphicsItem
 {
 public:
-    CanvasBoxShadow(QObject* parent);
-    void setFakeParent(CanvasBox* fakeParent);
-    void setOpacity(float opacity);
+    CanvasBoxShadow(QGraphicsItem* parent);
 
-protected:
-    virtual void draw(QPainter* painter);
+    void setBoxRect(const QRectF& rect);
 
 private:
-    CanvasBox* m_fakeParent;
+    QRectF m_box_rect;
+
+    virtual QRectF boundingRect() const;
+    virtual void paint(QPainter* painter, const QStyleOptionGraphicsItem* option, QWidget* widget);
 };
 
 END_NAMESPACE_PATCHCANVAS
@@ -0,0 +1,333 @@
+/*
+ * Patchbay Canvas engine using QGraphicsView/Scene
+ * Copyright (C) 2010-2012 Filipe Coelho <falktx@falktx.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * For a full copy of the GNU General Public License see the COPYING file
+ */
+
+
+#include "canvascommandqueue.h"
+
+#include <cstring>
+#include <QtCore/QHash>
+#include <QtCore/QSet>
+
+START_NAMESPACE_PATCHCANVAS
+
+// Positions only grow and are compared by difference, so they can wrap around safely
+static inline int CanvasSeqAdd(int pos, int count)
+{
+    return int(uint(pos) + uint(count));
+}
+
+static inline int CanvasSeqDiff(int a, int b)
+{
+    return int(uint(a) - uint(b));
+}
+
+void CanvasCommandSetName(canvas_command_t* command, const char* name)
+{
+    size_t size = name ? strlen(name) : 0;
+
+    if (size >= size_t(COMMAND_NAME_SIZE))
+    {
+        size = COMMAND_NAME_SIZE-1;
+
+        // Don't cut a multi-byte character in half
+        while (size > 0 && (uchar(name[size]) & 0xC0) == 0x80)
+            size--;
+    }
+
+    if (size > 0)
+        memcpy(command->name, name, size);
+
+    command->name[size] = '\0';
+}
+
+CanvasCommandQueue::CanvasCommandQueue(int size)
+{
+    int capacity = 2;
+    while (capacity < size)
+        capacity *= 2;
+
+    m_cells = new cell_t[capacity];
+    m_mask  = capacity-1;
+
+    for (int i=0; i < capacity; i++)
+        m_cells[i].sequence = i;
+
+    m_enqueue_pos = 0;
+    m_dequeue_pos = 0;
+    m_pending = 0;
+    m_dropped = 0;
+}
+
+CanvasCommandQueue::~CanvasCommandQueue()
+{
+    delete[] m_cells;
+}
+
+bool CanvasCommandQueue::push(const canvas_command_t& command)
+{
+    cell_t* cell;
+    int pos = m_enqueue_pos;
+
+    for (;;)
+    {
+        cell = &m_cells[pos & m_mask];
+        int diff = CanvasSeqDiff(cell->sequence.fetchAndAddAcquire(0), pos);
+
+        if (diff == 0)
+        {
+            // The cell is free, claim it unless another producer was faster
+            if (m_enqueue_pos.testAndSetRelaxed(pos, CanvasSeqAdd(pos, 1)))
+                break;
+        }
+        else if (diff < 0)
+        {
+            // The consumer has not taken this cell yet, the ring is full
+            m_dropped.fetchAndAddRelaxed(1);
+            return false;
+        }
+
+        pos = m_enqueue_pos;
+    }
+
+    cell->command = command;
+    cell->sequence.fetchAndStoreRelease(CanvasSeqAdd(pos, 1));
+    return true;
+}
+
+bool CanvasCommandQueue::markPending()
+{
+    return m_pending.testAndSetOrdered(0, 1);
+}
+
+bool CanvasCommandQueue::pop(canvas_command_t* command)
+{
+    cell_t* cell = &m_cells[m_dequeue_pos & m_mask];
+
+    if (CanvasSeqDiff(cell->sequence.fetchAndAddAcquire(0), CanvasSeqAdd(m_dequeue_pos, 1)) != 0)
+        return false;
+
+    *command = cell->command;
+
+    // Hand the cell back to producers for the next lap around the ring
+    cell->sequence.fetchAndStoreRelease(CanvasSeqAdd(m_dequeue_pos, m_mask+1));
+    m_dequeue_pos = CanvasSeqAdd(m_dequeue_pos, 1);
+    return true;
+}
+
+void CanvasCommandQueue::take(QVector<canvas_command_t>* commands)
+{
+    // Cleared first, a push racing with this will wake the GUI thread again
+    m_pending.fetchAndStoreOrdered(0);
+
+    canvas_command_t command;
+    while (pop(&command))
+        commands->append(command);
+
+    coalesce(commands);
+}
+
+void CanvasCommandQueue::discard()
+{
+    m_pending.fetchAndStoreOrdered(0);
+
+    canvas_command_t command;
+    while (pop(&command)) {}
+
+    m_dropped.fetchAndStoreRelaxed(0);
+}
+
+int CanvasCommandQueue::takeDropped()
+{
+    return m_dropped.fetchAndStoreRelaxed(0);
+}
+
+// Bookkeeping for one coalesce pass, all indexes point into the batch
+struct coalesce_t {
+    QVector<canvas_command_t>* commands;
+    QVector<bool> alive;
+    QHash<int, int> added_groups, added_ports, added_connections;
+    QHash<int, int> renamed_groups, renamed_ports;
+    QSet<int> removed_groups, removed_ports, removed_connections; // known to be gone from the canvas
+    QHash<int, QList<int> > group_ports;      // group id -> ports added to it in this batch
+    QHash<int, QList<int> > port_connections; // port id -> connections added to it in this batch
+};
+
+static void CanvasCoalesceAdd(coalesce_t& state, QHash<int, int>& added, int id, int index)
+{
+    // Same item added twice
+    if (added.contains(id))
+        state.alive[index] = false;
+    else
+        added.insert(id, index);
+}
+
+static void CanvasCoalesceRename(coalesce_t& state, const QHash<int, int>& added, QHash<int, int>& renamed, const QSet<int>& removed, int id, int index)
+{
+    int target = -1;
+
+    // Only the last name counts, it goes into the add or the earlier rename
+    if (added.contains(id))
+        target = added.value(id);
+    else if (removed.contains(id))
+        state.alive[index] = false;
+    else if (renamed.contains(id))
+        target = renamed.value(id);
+    else
+        renamed.insert(id, index);
+
+    if (target >= 0)
+    {
+        memcpy((*state.commands)[target].name, state.commands->at(index).name, COMMAND_NAME_SIZE);
+        state.alive[index] = false;
+    }
+}
+
+// Removal of something the canvas already has, duplicates are dropped
+static void CanvasCoalesceRemove(coalesce_t& state, QHash<int, int>* renamed, QSet<int>& removed, int id, int index)
+{
+    if (renamed && renamed->contains(id))
+        state.alive[renamed->take(id)] = false;
+
+    if (removed.contains(id))
+        state.alive[index] = false;
+    else
+        removed.insert(id);
+}
+
+static void CanvasCancelConnection(coalesce_t& state, int connection_id)
+{
+    state.alive[state.added_connections.take(connection_id)] = false;
+    state.removed_connections.insert(connection_id);
+}
+
+// Drops a port added in this batch, together with the connections added to it
+static void CanvasCancelPort(coalesce_t& state, int port_id)
+{
+    state.alive[state.added_ports.take(port_id)] = false;
+    state.removed_ports.insert(port_id);
+
+    foreach (const int& connection_id, state.port_connections.take(port_id))
+    {
+        // The id may have been reused since, only cancel what still touches this port
+        if (!state.added_connections.contains(connection_id))
+            continue;
+
+        const canvas_command_t& connection = state.commands->at(state.added_connections.value(connection_id));
+
+        if (connection.port_out_id == port_id || connection.port_in_id == port_id)
+            CanvasCancelConnection(state, connection_id);
+    }
+}
+
+// Drops a group added in this batch, together with the ports added to it
+static void CanvasCancelGroup(coalesce_t& state, int group_id)
+{
+    state.alive[state.added_groups.take(group_id)] = false;
+    state.removed_groups.insert(group_id);
+
+    foreach (const int& port_id, state.group_ports.take(group_id))
+    {
+        if (state.added_ports.contains(port_id) && state.commands->at(state.added_ports.value(port_id)).group_id == group_id)
+            CanvasCancelPort(state, port_id);
+    }
+}
+
+void CanvasCommandQueue::coalesce(QVector<canvas_command_t>* commands)
+{
+    if (commands->count() < 2)
+        return;
+
+    coalesce_t state;
+    state.commands = commands;
+    state.alive = QVector<bool>(commands->count(), true);
+
+    for (int i=0; i < commands->count(); i++)
+    {
+        const canvas_command_t& command = commands->at(i);
+
+        switch (command.type)
+        {
+        case COMMAND_ADD_GROUP:
+            CanvasCoalesceAdd(state, state.added_groups, command.group_id, i);
+            break;
+        case COMMAND_REMOVE_GROUP:
+            // Added and removed within the same frame, the canvas never sees it or its contents
+            if (state.added_groups.contains(command.group_id))
+            {
+                CanvasCancelGroup(state, command.group_id);
+                state.alive[i] = false;
+            }
+            else
+                CanvasCoalesceRemove(state, &state.renamed_groups, state.removed_groups, command.group_id, i);
+            break;
+        case COMMAND_RENAME_GROUP:
+            CanvasCoalesceRename(state, state.added_groups, state.renamed_groups, state.removed_groups, command.group_id, i);
+            break;
+        case COMMAND_ADD_PORT:
+            CanvasCoalesceAdd(state, state.added_ports, command.port_id, i);
+            if (state.alive[i])
+                state.group_ports[command.group_id].append(command.port_id);
+            break;
+        case COMMAND_REMOVE_PORT:
+            if (state.added_ports.contains(command.port_id))
+            {
+                CanvasCancelPort(state, command.port_id);
+                state.alive[i] = false;
+            }
+            else
+                CanvasCoalesceRemove(state, &state.renamed_ports, state.removed_ports, command.port_id, i);
+            break;
+        case COMMAND_RENAME_PORT:
+            CanvasCoalesceRename(state, state.added_ports, state.renamed_ports, state.removed_ports, command.port_id, i);
+            break;
+        case COMMAND_CONNECT_PORTS:
+            CanvasCoalesceAdd(state, state.added_connections, command.connection_id, i);
+            if (state.alive[i])
+            {
+                state.port_connections[command.port_out_id].append(command.connection_id);
+                state.port_connections[command.port_in_id].append(command.connection_id);
+            }
+            break;
+        case COMMAND_DISCONNECT_PORTS:
+            if (state.added_connections.contains(command.connection_id))
+            {
+                CanvasCancelConnection(state, command.connection_id);
+                state.alive[i] = false;
+            }
+            else
+                CanvasCoalesceRemove(state, 0, state.removed_connections, command.connection_id, i);
+            break;
+        default:
+            state.alive[i] = false;
+            break;
+        }
+    }
+
+    int count = 0;
+    for (int i=0; i < commands->count(); i++)
+    {
+        if (!state.alive[i])
+            continue;
+        if (count != i)
+            (*commands)[count] = commands->at(i);
+        count++;
+    }
+
+    commands->resize(count);
+}
+
+END_NAMESPACE_PATCHCANVAS
@@ -0,0 +1,103 @@
+/*
+ * Patchbay Canvas engine using QGraphicsView/Scene
+ * Copyright (C) 2010-2012 Filipe Coelho <falktx@falktx.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * For a full copy of the GNU General Public License see the COPYING file
+ */
+
+
+#ifndef CANVASCOMMANDQUEUE_H
+#define CANVASCOMMANDQUEUE_H
+
+#include <QtCore/QAtomicInt>
+#include <QtCore/QVector>
+
+// Only needs QtCore, so it builds on its own without the rest of the canvas
+#ifndef START_NAMESPACE_PATCHCANVAS
+# define START_NAMESPACE_PATCHCANVAS namespace PatchCanvas {
+# define END_NAMESPACE_PATCHCANVAS }
+#endif
+
+START_NAMESPACE_PATCHCANVAS
+
+enum CanvasCommandType {
+    COMMAND_ADD_GROUP        = 0,
+    COMMAND_REMOVE_GROUP     = 1,
+    COMMAND_RENAME_GROUP     = 2,
+    COMMAND_ADD_PORT         = 3,
+    COMMAND_REMOVE_PORT      = 4,
+    COMMAND_RENAME_PORT      = 5,
+    COMMAND_CONNECT_PORTS    = 6,
+    COMMAND_DISCONNECT_PORTS = 7
+};
+
+static const int COMMAND_NAME_SIZE = 256; // UTF-8, including the terminating zero
+
+// One graph change, plain data so it can be copied in and out of the ring without allocations
+struct canvas_command_t {
+    quint8 type;
+    quint8 split;
+    quint8 icon;
+    quint8 port_mode;
+    quint8 port_type;
+    int group_id;
+    int port_id;
+    int connection_id;
+    int port_out_id;
+    int port_in_id;
+    char name[COMMAND_NAME_SIZE];
+};
+
+void CanvasCommandSetName(canvas_command_t* command, const char* name);
+
+// Bounded lock-free ring, any thread can push, only the GUI thread takes.
+// Every cell carries a sequence number that tells producers and the consumer whose turn it is.
+class CanvasCommandQueue
+{
+public:
+    CanvasCommandQueue(int size=4096);
+    ~CanvasCommandQueue();
+
+    // Returns false when the ring is full, the command is dropped
+    bool push(const canvas_command_t& command);
+
+    // True only for the first push since the last take(), that one has to wake the GUI thread
+    bool markPending();
+
+    // Pops everything queued so far, duplicated and cancelling commands are removed
+    void take(QVector<canvas_command_t>* commands);
+    void discard();
+
+    // Number of commands dropped since the last call
+    int takeDropped();
+
+private:
+    struct cell_t {
+        QAtomicInt sequence;
+        canvas_command_t command;
+    };
+
+    cell_t* m_cells;
+    int m_mask;
+    QAtomicInt m_enqueue_pos;
+    int m_dequeue_pos;
+    QAtomicInt m_pending;
+    QAtomicInt m_dropped;
+
+    bool pop(canvas_command_t* command);
+    static void coalesce(QVector<canvas_command_t>* commands);
+};
+
+END_NAMESPACE_PATCHCANVAS
+
+#endif // CANVASCOMMANDQUEUE_H
@@ -18,29 +18,28 @@
 #include "canvasicon.h"
 
 #include <QtGui/QPainter>
-#include <QtGui/QGraphicsColorizeEffect>
+#include <QtGui/QStyleOptionGraphicsItem>
 #include <QtSvg/QSvgRenderer>
 
+#include "canvasiconcache.h"
+
 START_NAMESPACE_PATCHCANVAS
 
 CanvasIcon::CanvasIcon(Icon icon, QString name, QGraphicsItem* parent) :
     QGraphicsSvgItem(parent)
 {
     m_renderer = 0;
+    m_color = canvas.theme->box_text.color();
     p_size = QRectF(0, 0, 0, 0);
 
-    m_colorFX = new QGraphicsColorizeEffect(this);
-    m_colorFX->setColor(canvas.theme->box_text.color());
-
-    setGraphicsEffect(m_colorFX);
     setIcon(icon, name);
+
+    if (options.use_item_cache)
+        setCacheMode(QGraphicsItem::DeviceCoordinateCache);
 }
 
 CanvasIcon::~CanvasIcon()
 {
-    if (m_renderer)
-        delete m_renderer;
-    delete m_colorFX;
 }
 
 void CanvasIcon::setIcon(Icon icon, QString name)
@@ -48,6 +47,8 @@ void CanvasIcon::setIcon(Icon icon, QString name)
     name = name.toLower();
     QString icon_path;
 
+    prepareGeometryChange();
+
     if (icon == ICON_APPLICATION)
     {
         p_size = QRectF(3, 2, 19, 18);
@@ -97,14 +98,15 @@ void CanvasIcon::setIcon(Icon icon, QString name)
     else
     {
         p_size = QRectF(0, 0, 0, 0);
+        m_icon_path.clear();
+        m_renderer = 0;
         qCritical("PatchCanvas::CanvasIcon->setIcon(%s, %s) - unsupported Icon requested", icon2str(icon), name.toUtf8().constData());
         return;
     }
 
-    if (m_renderer)
-        delete m_renderer;
-
-    m_renderer = new QSvgRenderer(icon_path, canvas.scene);
+    // Renderers are shared by every box showing the same icon
+    m_icon_path = icon_path;
+    m_renderer = CanvasIconCache::getRenderer(icon_path);
     setSharedRenderer(m_renderer);
     update();
 }
@@ -121,11 +123,17 @@ QRectF CanvasIcon::boundingRect() const
 
 void CanvasIcon::paint(QPainter* painter, const QStyleOptionGraphicsItem* option, QWidget* widget)
 {
+    if (canvas.detail_level != DETAIL_FULL)
+        return;
+
     if (m_renderer)
     {
-        painter->setRenderHint(QPainter::Antialiasing, false);
-        painter->setRenderHint(QPainter::TextAntialiasing, false);
-        m_renderer->render(painter, p_size);
+        // Rasterize at the current zoom so icons stay sharp, then reuse the pixmap
+        qreal scale = QStyleOptionGraphicsItem::levelOfDetailFromTransform(painter->worldTransform());
+        QPixmap pixmap = CanvasIconCache::getPixmap(m_icon_path, (p_size.size()*scale).toSize(), m_color);
+
+        if (!pixmap.isNull())
+            painter->drawPixmap(p_size, pixmap, pixmap.rect());
     }
     else
         QGraphicsSvgItem::paint(painter, option, widget);
@@ -23,7 +23,6 @@
 #include "patchcanvas.h"
 
 class QPainter;
-class QGraphicsColorizeEffect;
 class QSvgRenderer;
 
 START_NAMESPACE_PATCHCANVAS
@@ -39,8 +38,9 @@ public:
     virtual int type() const;
 
 private:
-    QGraphicsColorizeEffect* m_colorFX;
     QSvgRenderer* m_renderer;
+    QString m_icon_path;
+    QColor m_color;
     QRectF p_size;
 
     virtual QRectF boundingRect() const;
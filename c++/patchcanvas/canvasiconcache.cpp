@@ -0,0 +1,98 @@
+/*
+ * Patchbay Canvas engine using QGraphicsView/Scene
+ * Copyright (C) 2010-2012 Filipe Coelho <falktx@falktx.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * For a full copy of the GNU General Public License see the COPYING file
+ */
+
+#include "canvasiconcache.h"
+
+#include <QtGui/QImage>
+#include <QtGui/QPainter>
+#include <QtGui/QPixmapCache>
+#include <QtSvg/QSvgRenderer>
+
+START_NAMESPACE_PATCHCANVAS
+
+CanvasIconCache::~CanvasIconCache()
+{
+    foreach (QSvgRenderer* renderer, m_renderers)
+        delete renderer;
+}
+
+CanvasIconCache* CanvasIconCache::instance()
+{
+    static CanvasIconCache cache;
+    return &cache;
+}
+
+QSvgRenderer* CanvasIconCache::getRenderer(const QString& icon_path)
+{
+    CanvasIconCache* cache = instance();
+    QSvgRenderer* renderer = cache->m_renderers.value(icon_path, 0);
+
+    if (!renderer)
+    {
+        renderer = new QSvgRenderer(icon_path);
+        cache->m_renderers.insert(icon_path, renderer);
+    }
+
+    return renderer;
+}
+
+QPixmap CanvasIconCache::getPixmap(const QString& icon_path, const QSize& size, const QColor& color)
+{
+    if (size.isEmpty())
+        return QPixmap();
+
+    QString key = QString("PatchCanvas:%1:%2x%3:%4").arg(icon_path).arg(size.width()).arg(size.height()).arg(color.rgba(), 0, 16);
+    QPixmap pixmap;
+
+    if (QPixmapCache::find(key, &pixmap))
+        return pixmap;
+
+    QImage image(size, QImage::Format_ARGB32_Premultiplied);
+    image.fill(0);
+
+    QPainter painter(&image);
+    getRenderer(icon_path)->render(&painter, QRectF(QPointF(0, 0), size));
+    painter.end();
+
+    // Same look as QGraphicsColorizeEffect: grayscale, screened with the color, original alpha kept
+    QImage colorized(image);
+
+    for (int y=0; y < colorized.height(); y++)
+    {
+        QRgb* line = reinterpret_cast<QRgb*>(colorized.scanLine(y));
+
+        for (int x=0; x < colorized.width(); x++)
+        {
+            int gray = qGray(line[x]);
+            line[x] = qRgba(gray, gray, gray, qAlpha(line[x]));
+        }
+    }
+
+    painter.begin(&colorized);
+    painter.setCompositionMode(QPainter::CompositionMode_Screen);
+    painter.fillRect(colorized.rect(), color);
+    painter.setCompositionMode(QPainter::CompositionMode_DestinationIn);
+    painter.drawImage(0, 0, image);
+    painter.end();
+
+    pixmap = QPixmap::fromImage(colorized);
+    QPixmapCache::insert(key, pixmap);
+
+    return pixmap;
+}
+
+END_NAMESPACE_PATCHCANVAS
@@ -15,21 +15,35 @@
  * For a full copy of the GNU General Public License see the COPYING file
  */
 
-#ifndef CANVASPORTGLOW_H
-#define CANVASPORTGLOW_H
+#ifndef CANVASICONCACHE_H
+#define CANVASICONCACHE_H
 
-#include <QGraphicsDropShadowEffect>
+#include <QtCore/QHash>
+#include <QtGui/QColor>
+#include <QtGui/QPixmap>
 
 #include "patchcanvas.h"
 
+class QSvgRenderer;
+
 START_NAMESPACE_PATCHCANVAS
 
-class CanvasPortGlow : public QGraphicsDropShadowEffect
+// Process-wide store of icon renderers and their rasterized pixmaps
+class CanvasIconCache
 {
 public:
-    CanvasPortGlow(PortType port_type, QObject* parent);
+    static QSvgRenderer* getRenderer(const QString& icon_path);
+    static QPixmap getPixmap(const QString& icon_path, const QSize& size, const QColor& color);
+
+private:
+    CanvasIconCache() {}
+    ~CanvasIconCache();
+
+    static CanvasIconCache* instance();
+
+    QHash<QString, QSvgRenderer*> m_renderers;
 };
 
 END_NAMESPACE_PATCHCANVAS
 
-#endif // CANVASPORTGLOW_H
+#endif // CANVASICONCACHE_H
@@ -0,0 +1,106 @@
+/*
+ * Patchbay Canvas engine using QGraphicsView/Scene
+ * Copyright (C) 2010-2012 Filipe Coelho <falktx@falktx.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * For a full copy of the GNU General Public License see the COPYING file
+ */
+
+#include "canvaslayerline.h"
+
+#include "canvaslinelayer.h"
+#include "canvasport.h"
+
+START_NAMESPACE_PATCHCANVAS
+
+CanvasLayerLine::CanvasLayerLine(CanvasPort* item1_, CanvasPort* item2_, CanvasLineLayer* layer)
+{
+    item1 = item1_;
+    item2 = item2_;
+    m_layer = layer;
+    m_locked = false;
+
+    m_layer_index = m_layer->addLine(this, item1->getPortType(), item2->getPortType());
+
+    // Port positions are not final yet while batching, the line gets built at endUpdate()
+    if (canvas.update_depth > 0)
+        canvas.dirty_lines.insert(this);
+    else
+        updateLinePos();
+}
+
+CanvasLayerLine::~CanvasLayerLine()
+{
+    canvas.dirty_lines.remove(this);
+}
+
+void CanvasLayerLine::deleteFromScene()
+{
+    m_layer->removeLine(m_layer_index);
+    delete this;
+}
+
+bool CanvasLayerLine::isLocked() const
+{
+    return m_locked;
+}
+
+void CanvasLayerLine::setLocked(bool yesno)
+{
+    m_locked = yesno;
+}
+
+bool CanvasLayerLine::isLineSelected() const
+{
+    return m_layer->isLineSelected(m_layer_index);
+}
+
+void CanvasLayerLine::setLineSelected(bool yesno)
+{
+    if (m_locked)
+        return;
+
+    m_layer->setLineSelected(m_layer_index, yesno);
+}
+
+void CanvasLayerLine::updateLinePos()
+{
+    if (item1->getPortMode() == PORT_MODE_OUTPUT)
+    {
+        QPointF item1_pos(item1->scenePos().x() + item1->getPortWidth()+12, item1->scenePos().y()+7.5);
+        QPointF item2_pos(item2->scenePos().x(), item2->scenePos().y()+7.5);
+
+        m_layer->setLinePos(m_layer_index, item1_pos, item2_pos);
+    }
+}
+
+int CanvasLayerLine::type() const
+{
+    return CanvasLineLayerType;
+}
+
+void CanvasLayerLine::setZValue(qreal /*z*/)
+{
+    // All lines share one item, its z value follows the boxes instead
+}
+
+int CanvasLayerLine::getLayerIndex() const
+{
+    return m_layer_index;
+}
+
+void CanvasLayerLine::setLayerIndex(int index)
+{
+    m_layer_index = index;
+}
+
+END_NAMESPACE_PATCHCANVAS
@@ -0,0 +1,63 @@
+/*
+ * Patchbay Canvas engine using QGraphicsView/Scene
+ * Copyright (C) 2010-2012 Filipe Coelho <falktx@falktx.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * For a full copy of the GNU General Public License see the COPYING file
+ */
+
+#ifndef CANVASLAYERLINE_H
+#define CANVASLAYERLINE_H
+
+#include "abstractcanvasline.h"
+
+START_NAMESPACE_PATCHCANVAS
+
+class CanvasPort;
+class CanvasLineLayer;
+
+// Connection line drawn by the shared line layer instead of its own scene item
+class CanvasLayerLine :
+        public AbstractCanvasLine
+{
+public:
+    CanvasLayerLine(CanvasPort* item1, CanvasPort* item2, CanvasLineLayer* layer);
+    ~CanvasLayerLine();
+
+    virtual void deleteFromScene();
+
+    virtual bool isLocked() const;
+    virtual void setLocked(bool yesno);
+
+    virtual bool isLineSelected() const;
+    virtual void setLineSelected(bool yesno);
+
+    virtual void updateLinePos();
+
+    virtual int type() const;
+
+    virtual void setZValue(qreal z);
+
+    int getLayerIndex() const;
+    void setLayerIndex(int index);
+
+private:
+    CanvasPort* item1;
+    CanvasPort* item2;
+    CanvasLineLayer* m_layer;
+    int m_layer_index;
+    bool m_locked;
+};
+
+END_NAMESPACE_PATCHCANVAS
+
+#endif // CANVASLAYERLINE_H
@@ -0,0 +1,500 @@
+/*
+ * Patchbay Canvas engine using QGraphicsView/Scene
+ * Copyright (C) 2010-2012 Filipe Coelho <falktx@falktx.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * For a full copy of the GNU General Public License see the COPYING file
+ */
+
+
+#include "canvaslayoutstore.h"
+
+#include <cstdio>
+#include <cstring>
+#include <QtCore/QCoreApplication>
+#include <QtCore/QSettings>
+#include <QtCore/QStringList>
+#include <QtCore/QtConcurrentRun>
+#include <QtCore/QtEndian>
+
+#ifdef Q_OS_WIN
+# include <windows.h>
+#endif
+
+START_NAMESPACE_PATCHCANVAS
+
+/*
+ * File layout, all values little endian:
+ *
+ *   header   magic "PCLS", version, slot count (power of 2), names offset, names size
+ *   slots    open addressing on the name hash, a zero hash marks an empty slot
+ *   names    UTF-8 group names, referenced by offset and length from the slots
+ */
+static const char    LAYOUT_MAGIC[4]    = { 'P', 'C', 'L', 'S' };
+static const quint32 LAYOUT_VERSION     = 1;
+static const int     LAYOUT_HEADER_SIZE = 20;
+static const int     LAYOUT_SLOT_SIZE   = 72; // hash, name offset, name length, split, flags, 3 positions
+
+static quint64 CanvasLayoutHash(const QByteArray& name)
+{
+    // FNV-1a, stable across runs and Qt versions
+    quint64 hash = Q_UINT64_C(14695981039346656037);
+
+    for (int i=0; i < name.size(); i++)
+    {
+        hash ^= uchar(name[i]);
+        hash *= Q_UINT64_C(1099511628211);
+    }
+
+    return hash ? hash : 1;
+}
+
+static double CanvasLayoutReadDouble(const uchar* data)
+{
+    quint64 bits = qFromLittleEndian<quint64>(data);
+    double value;
+    memcpy(&value, &bits, sizeof(double));
+    return value;
+}
+
+static void CanvasLayoutWriteDouble(double value, uchar* data)
+{
+    quint64 bits;
+    memcpy(&bits, &value, sizeof(double));
+    qToLittleEndian<quint64>(bits, data);
+}
+
+static QString CanvasLayoutTmpPath(const QString& path)
+{
+    // One per process, clients sharing the file must not write into each other's
+    return path + QString(".%1.tmp").arg(QCoreApplication::applicationPid());
+}
+
+CanvasLayoutStore::CanvasLayoutStore()
+{
+    m_map = 0;
+    m_slot_count   = 0;
+    m_names_offset = 0;
+    m_names_size   = 0;
+    m_dirty = false;
+}
+
+CanvasLayoutStore::~CanvasLayoutStore()
+{
+    close();
+}
+
+void CanvasLayoutStore::open(const QString& path, QSettings* settings)
+{
+    close();
+
+    m_path = path;
+    mapFile();
+
+    if (!m_map && settings)
+    {
+        importSettings(settings);
+        sync();
+    }
+}
+
+void CanvasLayoutStore::close()
+{
+    finishWrite();
+
+    // Nothing may run after this, write the last changes right here
+    bool written = false;
+
+    if (m_dirty && !m_path.isEmpty())
+    {
+        remapFile();
+        written = writeFile(m_path, snapshot());
+    }
+
+    unmapFile();
+
+    if (written)
+        replaceFile(m_path);
+
+    m_changes.clear();
+    m_dirty = false;
+}
+
+bool CanvasLayoutStore::sync()
+{
+    // The previous write is usually long done, this only orders them
+    finishWrite();
+
+    if (!m_dirty || m_path.isEmpty())
+        return false;
+
+    // Changes move aside while being written, new ones start a fresh overlay
+    m_writing = m_changes;
+    m_changes.clear();
+    m_dirty = false;
+
+    remapFile();
+    m_write = QtConcurrent::run(CanvasLayoutStore::writeFile, m_path, snapshot());
+    return true;
+}
+
+void CanvasLayoutStore::finishWrite()
+{
+    if (m_writing.isEmpty())
+        return;
+
+    m_write.waitForFinished();
+
+    // Windows can't replace a file that is still open, the old one is only unmapped here
+    bool written = m_write.result();
+
+    if (written)
+    {
+        unmapFile();
+        written = replaceFile(m_path);
+        mapFile();
+    }
+
+    if (!written)
+    {
+        // Keep the changes for the next try, newer ones win
+        for (QHash<QString, layout_group_t>::const_iterator it = m_writing.constBegin(); it != m_writing.constEnd(); ++it)
+        {
+            if (!m_changes.contains(it.key()))
+                m_changes.insert(it.key(), it.value());
+        }
+
+        m_dirty = true;
+    }
+
+    m_writing.clear();
+}
+
+bool CanvasLayoutStore::getPos(const QString& group_name, PortMode port_mode, QPointF* pos) const
+{
+    layout_group_t group;
+
+    if (!findGroup(group_name, &group) || !group.has_pos[port_mode])
+        return false;
+
+    *pos = group.pos[port_mode];
+    return true;
+}
+
+SplitOption CanvasLayoutStore::getSplit(const QString& group_name) const
+{
+    layout_group_t group;
+
+    if (!findGroup(group_name, &group))
+        return SPLIT_UNDEF;
+
+    return group.split;
+}
+
+void CanvasLayoutStore::setPos(const QString& group_name, PortMode port_mode, const QPointF& pos)
+{
+    layout_group_t& group = changeGroup(group_name);
+    group.has_pos[port_mode] = true;
+    group.pos[port_mode] = pos;
+    m_dirty = true;
+}
+
+void CanvasLayoutStore::setSplit(const QString& group_name, SplitOption split)
+{
+    changeGroup(group_name).split = split;
+    m_dirty = true;
+}
+
+bool CanvasLayoutStore::findGroup(const QString& group_name, layout_group_t* group) const
+{
+    QHash<QString, layout_group_t>::const_iterator it = m_changes.constFind(group_name);
+
+    if (it != m_changes.constEnd())
+    {
+        *group = it.value();
+        return true;
+    }
+
+    it = m_writing.constFind(group_name);
+
+    if (it != m_writing.constEnd())
+    {
+        *group = it.value();
+        return true;
+    }
+
+    if (!m_map)
+        return false;
+
+    QByteArray name = group_name.toUtf8();
+    quint64 hash = CanvasLayoutHash(name);
+    quint32 mask = m_slot_count-1;
+
+    quint32 i = quint32(hash) & mask;
+
+    for (quint32 probes=0; probes < m_slot_count; probes++, i = (i+1) & mask)
+    {
+        const uchar* slot = m_map + LAYOUT_HEADER_SIZE + i*LAYOUT_SLOT_SIZE;
+        quint64 slot_hash = qFromLittleEndian<quint64>(slot);
+
+        if (slot_hash == 0)
+            return false;
+
+        if (slot_hash != hash)
+            continue;
+
+        quint32 name_offset = qFromLittleEndian<quint32>(slot+8);
+        quint32 name_length = qFromLittleEndian<quint32>(slot+12);
+
+        if (name_length != quint32(name.size()) || name_offset+name_length > m_names_size ||
+            memcmp(m_map+m_names_offset+name_offset, name.constData(), name_length) != 0)
+            continue;
+
+        quint32 flags = qFromLittleEndian<quint32>(slot+20);
+
+        group->split = static_cast<SplitOption>(qFromLittleEndian<qint32>(slot+16));
+
+        for (int j=0; j < 3; j++)
+        {
+            group->has_pos[j] = (flags & (1 << j));
+            group->pos[j] = QPointF(CanvasLayoutReadDouble(slot+24+j*16), CanvasLayoutReadDouble(slot+32+j*16));
+        }
+
+        return true;
+    }
+
+    return false;
+}
+
+layout_group_t& CanvasLayoutStore::changeGroup(const QString& group_name)
+{
+    QHash<QString, layout_group_t>::iterator it = m_changes.find(group_name);
+
+    if (it != m_changes.end())
+        return it.value();
+
+    // Start from what the file has, only the changed fields get replaced
+    layout_group_t group;
+
+    if (!findGroup(group_name, &group))
+    {
+        group.split = SPLIT_UNDEF;
+
+        for (int i=0; i < 3; i++)
+            group.has_pos[i] = false;
+    }
+
+    return m_changes.insert(group_name, group).value();
+}
+
+void CanvasLayoutStore::mapFile()
+{
+    m_file.setFileName(m_path);
+
+    if (!m_file.exists() || !m_file.open(QIODevice::ReadOnly))
+        return;
+
+    qint64 size = m_file.size();
+    const uchar* map = (size >= LAYOUT_HEADER_SIZE) ? m_file.map(0, size) : 0;
+
+    if (map && memcmp(map, LAYOUT_MAGIC, 4) == 0 && qFromLittleEndian<quint32>(map+4) == LAYOUT_VERSION)
+    {
+        quint32 slot_count   = qFromLittleEndian<quint32>(map+8);
+        quint32 names_offset = qFromLittleEndian<quint32>(map+12);
+        quint32 names_size   = qFromLittleEndian<quint32>(map+16);
+
+        // 64-bit math, a corrupt slot count must not wrap around into a small table size
+        qint64 slots_end = qint64(LAYOUT_HEADER_SIZE) + qint64(slot_count)*LAYOUT_SLOT_SIZE;
+
+        bool valid = (slot_count > 0 && (slot_count & (slot_count-1)) == 0 &&
+                      slots_end <= size && qint64(names_offset) == slots_end &&
+                      qint64(names_offset)+names_size <= size);
+
+        if (valid)
+        {
+            m_map = map;
+            m_slot_count   = slot_count;
+            m_names_offset = names_offset;
+            m_names_size   = names_size;
+            return;
+        }
+    }
+
+    qWarning("PatchCanvas::CanvasLayoutStore::mapFile() - ignoring invalid layout file '%s'", m_path.toUtf8().constData());
+
+    if (map)
+        m_file.unmap(const_cast<uchar*>(map));
+    m_file.close();
+}
+
+void CanvasLayoutStore::unmapFile()
+{
+    if (m_map)
+        m_file.unmap(const_cast<uchar*>(m_map));
+
+    m_file.close();
+
+    m_map = 0;
+    m_slot_count   = 0;
+    m_names_offset = 0;
+    m_names_size   = 0;
+}
+
+void CanvasLayoutStore::remapFile()
+{
+    // Other clients share the file, what they wrote since the last map has to be kept
+    unmapFile();
+    mapFile();
+}
+
+void CanvasLayoutStore::importSettings(QSettings* settings)
+{
+    settings->beginGroup("CanvasPositions");
+
+    foreach (const QString& key, settings->allKeys())
+    {
+        if (key.endsWith("_SPLIT"))
+            setSplit(key.left(key.length()-6), static_cast<SplitOption>(settings->value(key).toInt()));
+        else if (key.endsWith("_OUTPUT"))
+            setPos(key.left(key.length()-7), PORT_MODE_OUTPUT, settings->value(key).toPointF());
+        else if (key.endsWith("_INPUT"))
+            setPos(key.left(key.length()-6), PORT_MODE_INPUT, settings->value(key).toPointF());
+        else
+            setPos(key, PORT_MODE_NULL, settings->value(key).toPointF());
+    }
+
+    settings->endGroup();
+}
+
+QHash<QString, layout_group_t> CanvasLayoutStore::snapshot() const
+{
+    QHash<QString, layout_group_t> groups;
+
+    for (quint32 i=0; m_map && i < m_slot_count; i++)
+    {
+        const uchar* slot = m_map + LAYOUT_HEADER_SIZE + i*LAYOUT_SLOT_SIZE;
+
+        if (qFromLittleEndian<quint64>(slot) == 0)
+            continue;
+
+        quint32 name_offset = qFromLittleEndian<quint32>(slot+8);
+        quint32 name_length = qFromLittleEndian<quint32>(slot+12);
+
+        if (name_offset+name_length > m_names_size)
+            continue;
+
+        QString name = QString::fromUtf8((const char*)m_map+m_names_offset+name_offset, name_length);
+
+        if (m_changes.contains(name) || m_writing.contains(name))
+            continue;
+
+        layout_group_t group;
+        findGroup(name, &group);
+        groups.insert(name, group);
+    }
+
+    for (QHash<QString, layout_group_t>::const_iterator it = m_writing.constBegin(); it != m_writing.constEnd(); ++it)
+        groups.insert(it.key(), it.value());
+
+    for (QHash<QString, layout_group_t>::const_iterator it = m_changes.constBegin(); it != m_changes.constEnd(); ++it)
+        groups.insert(it.key(), it.value());
+
+    return groups;
+}
+
+bool CanvasLayoutStore::writeFile(const QString& path, const QHash<QString, layout_group_t>& groups)
+{
+    // Keep the table at most half full
+    quint32 slot_count = 16;
+    while (slot_count < quint32(groups.count())*2)
+        slot_count *= 2;
+
+    QByteArray names;
+    QByteArray data(LAYOUT_HEADER_SIZE + slot_count*LAYOUT_SLOT_SIZE, '\0');
+    uchar* base = (uchar*)data.data();
+
+    for (QHash<QString, layout_group_t>::const_iterator it = groups.constBegin(); it != groups.constEnd(); ++it)
+    {
+        QByteArray name = it.key().toUtf8();
+        quint64 hash = CanvasLayoutHash(name);
+        quint32 mask = slot_count-1;
+        quint32 i = quint32(hash) & mask;
+
+        while (qFromLittleEndian<quint64>(base + LAYOUT_HEADER_SIZE + i*LAYOUT_SLOT_SIZE) != 0)
+            i = (i+1) & mask;
+
+        uchar* slot = base + LAYOUT_HEADER_SIZE + i*LAYOUT_SLOT_SIZE;
+        const layout_group_t& group = it.value();
+        quint32 flags = 0;
+
+        qToLittleEndian<quint64>(hash, slot);
+        qToLittleEndian<quint32>(names.size(), slot+8);
+        qToLittleEndian<quint32>(name.size(), slot+12);
+        qToLittleEndian<qint32>(group.split, slot+16);
+
+        for (int j=0; j < 3; j++)
+        {
+            if (group.has_pos[j])
+                flags |= (1 << j);
+
+            CanvasLayoutWriteDouble(group.pos[j].x(), slot+24+j*16);
+            CanvasLayoutWriteDouble(group.pos[j].y(), slot+32+j*16);
+        }
+
+        qToLittleEndian<quint32>(flags, slot+20);
+        names.append(name);
+    }
+
+    memcpy(base, LAYOUT_MAGIC, 4);
+    qToLittleEndian<quint32>(LAYOUT_VERSION, base+4);
+    qToLittleEndian<quint32>(slot_count, base+8);
+    qToLittleEndian<quint32>(LAYOUT_HEADER_SIZE + slot_count*LAYOUT_SLOT_SIZE, base+12);
+    qToLittleEndian<quint32>(names.size(), base+16);
+
+    data.append(names);
+
+    // Write a new file next to the old one, replaceFile() swaps it in later
+    QString tmp_path = CanvasLayoutTmpPath(path);
+    QFile file(tmp_path);
+
+    if (!file.open(QIODevice::WriteOnly|QIODevice::Truncate) || file.write(data) != data.size())
+    {
+        qWarning("PatchCanvas::CanvasLayoutStore::writeFile() - unable to write '%s'", tmp_path.toUtf8().constData());
+        file.close();
+        QFile::remove(tmp_path);
+        return false;
+    }
+
+    return true;
+}
+
+bool CanvasLayoutStore::replaceFile(const QString& path)
+{
+    QString tmp_path = CanvasLayoutTmpPath(path);
+
+    // A single rename, other readers see either the old file or the new one
+#ifdef Q_OS_WIN
+    bool replaced = MoveFileExW((const wchar_t*)tmp_path.utf16(), (const wchar_t*)path.utf16(), MOVEFILE_REPLACE_EXISTING|MOVEFILE_WRITE_THROUGH);
+#else
+    bool replaced = (::rename(QFile::encodeName(tmp_path).constData(), QFile::encodeName(path).constData()) == 0);
+#endif
+
+    if (!replaced)
+    {
+        qWarning("PatchCanvas::CanvasLayoutStore::replaceFile() - unable to replace '%s'", path.toUtf8().constData());
+        QFile::remove(tmp_path);
+    }
+
+    return replaced;
+}
+
+END_NAMESPACE_PATCHCANVAS
@@ -0,0 +1,96 @@
+/*
+ * Patchbay Canvas engine using QGraphicsView/Scene
+ * Copyright (C) 2010-2012 Filipe Coelho <falktx@falktx.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * For a full copy of the GNU General Public License see the COPYING file
+ */
+
+
+#ifndef CANVASLAYOUTSTORE_H
+#define CANVASLAYOUTSTORE_H
+
+#include <QtCore/QFile>
+#include <QtCore/QFuture>
+#include <QtCore/QHash>
+#include <QtCore/QPointF>
+
+#include "patchcanvas.h"
+
+class QSettings;
+
+START_NAMESPACE_PATCHCANVAS
+
+// Saved layout of one group, positions are indexed by PortMode (NULL is the joined box)
+struct layout_group_t {
+    SplitOption split;
+    bool has_pos[3];
+    QPointF pos[3];
+};
+
+// Group positions and split state, kept in a memory-mapped hash table on disk.
+// Lookups read the mapped file directly, changes stay in memory until sync()
+// writes a new file in the background.
+class CanvasLayoutStore
+{
+public:
+    CanvasLayoutStore();
+    ~CanvasLayoutStore();
+
+    // Imports the old "CanvasPositions" settings when there is no valid file yet
+    void open(const QString& path, QSettings* settings);
+    void close();
+
+    // Starts writing the changes in the background, true while that write still has to be picked up
+    bool sync();
+
+    bool getPos(const QString& group_name, PortMode port_mode, QPointF* pos) const;
+    SplitOption getSplit(const QString& group_name) const;
+
+    void setPos(const QString& group_name, PortMode port_mode, const QPointF& pos);
+    void setSplit(const QString& group_name, SplitOption split);
+
+private:
+    QString m_path;
+    QFile m_file;
+    const uchar* m_map;
+    quint32 m_slot_count;
+    quint32 m_names_offset;
+    quint32 m_names_size;
+
+    QHash<QString, layout_group_t> m_changes;
+    QHash<QString, layout_group_t> m_writing; // changes of the write in flight
+    bool m_dirty;
+    QFuture<bool> m_write;
+
+    bool findGroup(const QString& group_name, layout_group_t* group) const;
+    layout_group_t& changeGroup(const QString& group_name);
+
+    // Waits for the last write, then swaps in and maps the new file or keeps its changes for the next one
+    void finishWrite();
+
+    void mapFile();
+    void unmapFile();
+    // Maps the file as it is on disk now, snapshot() then merges our changes over it
+    void remapFile();
+    void importSettings(QSettings* settings);
+
+    QHash<QString, layout_group_t> snapshot() const;
+    // Writes a temporary file next to path, safe to run in the background
+    static bool writeFile(const QString& path, const QHash<QString, layout_group_t>& groups);
+    // Moves that file over path, the file must not be open here anymore
+    static bool replaceFile(const QString& path);
+};
+
+END_NAMESPACE_PATCHCANVAS
+
+#endif // CANVASLAYOUTSTORE_H
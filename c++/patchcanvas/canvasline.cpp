@@ -20,7 +20,6 @@
 #include <QtGui/QPainter>
 
 #include "canvasport.h"
-#include "canvasportglow.h"
 
 START_NAMESPACE_PATCHCANVAS
 
@@ -32,13 +31,21 @@ CanvasLine::CanvasLine(CanvasPort* item1_, CanvasPort* item2_, QGraphicsItem* pa
 
     m_locked = false;
     m_lineSelected = false;
+    m_pos_valid = false;
 
     setGraphicsEffect(0);
-    updateLinePos();
+
+    // Port positions are not final yet while batching, the line gets built at endUpdate()
+    if (canvas.update_depth > 0)
+        canvas.dirty_lines.insert(this);
+    else
+        updateLinePos();
 }
 
 CanvasLine::~CanvasLine()
 {
+    canvas.dirty_lines.remove(this);
+    CanvasCancelItemFX(this);
     setGraphicsEffect(0);
 }
 
@@ -68,14 +75,6 @@ void CanvasLine::setLineSelected(bool yesno)
     if (m_locked)
         return;
 
-    if (options.eyecandy == EYECANDY_FULL)
-    {
-        if (yesno)
-            setGraphicsEffect(new CanvasPortGlow(item1->getPortType(), toGraphicsObject()));
-        else
-            setGraphicsEffect(0);
-    }
-
     m_lineSelected = yesno;
     updateLineGradient();
 }
@@ -84,7 +83,18 @@ void CanvasLine::updateLinePos()
 {
     if (item1->getPortMode() == PORT_MODE_OUTPUT)
     {
-        QLineF line(item1->scenePos().x() + item1->getPortWidth()+12, item1->scenePos().y()+7.5, item2->scenePos().x(), item2->scenePos().y()+7.5);
+        QPointF item1_pos(item1->scenePos().x() + item1->getPortWidth()+12, item1->scenePos().y()+7.5);
+        QPointF item2_pos(item2->scenePos().x(), item2->scenePos().y()+7.5);
+
+        // Only rebuild when one of the ends actually moved
+        if (m_pos_valid && item1_pos == m_item1_pos && item2_pos == m_item2_pos)
+            return;
+
+        m_item1_pos = item1_pos;
+        m_item2_pos = item2_pos;
+        m_pos_valid = true;
+
+        QLineF line(item1_pos, item2_pos);
         setLine(line);
 
         m_lineSelected = false;
@@ -99,49 +109,47 @@ int CanvasLine::type() const
 
 void CanvasLine::updateLineGradient()
 {
-    short pos1, pos2;
-    int pos_top = boundingRect().top();
-    int pos_bot = boundingRect().bottom();
+    int pos_top = QGraphicsLineItem::boundingRect().top();
+    int pos_bot = QGraphicsLineItem::boundingRect().bottom();
+
+    PortType port_type1 = item1->getPortType();
+    PortType port_type2 = item2->getPortType();
 
+    QPen pen;
     if (item2->scenePos().y() >= item1->scenePos().y())
-    {
-        pos1 = 0;
-        pos2 = 1;
-    }
+        pen = canvas.theme->getLinePen(port_type1, port_type2, m_lineSelected);
     else
+        pen = canvas.theme->getLinePen(port_type2, port_type1, m_lineSelected);
+
+    if (pen.brush().gradient())
     {
-        pos1 = 1;
-        pos2 = 0;
+        QBrush brush(pen.brush());
+        brush.setTransform(Theme::getLineBrushTransform(pos_top, pos_bot));
+        pen.setBrush(brush);
     }
 
-    PortType port_type1 = item1->getPortType();
-    PortType port_type2 = item2->getPortType();
-    QLinearGradient port_gradient(0, pos_top, 0, pos_bot);
-
-    if (port_type1 == PORT_TYPE_AUDIO_JACK)
-        port_gradient.setColorAt(pos1, m_lineSelected ? canvas.theme->line_audio_jack_sel : canvas.theme->line_audio_jack);
-    else if (port_type1 == PORT_TYPE_MIDI_JACK)
-        port_gradient.setColorAt(pos1, m_lineSelected ? canvas.theme->line_midi_jack_sel : canvas.theme->line_midi_jack);
-    else if (port_type1 == PORT_TYPE_MIDI_A2J)
-        port_gradient.setColorAt(pos1, m_lineSelected ? canvas.theme->line_midi_a2j_sel : canvas.theme->line_midi_a2j);
-    else if (port_type1 == PORT_TYPE_MIDI_ALSA)
-        port_gradient.setColorAt(pos1, m_lineSelected ? canvas.theme->line_midi_alsa_sel : canvas.theme->line_midi_alsa);
-
-    if (port_type2 == PORT_TYPE_AUDIO_JACK)
-        port_gradient.setColorAt(pos2, m_lineSelected ? canvas.theme->line_audio_jack_sel : canvas.theme->line_audio_jack);
-    else if (port_type2 == PORT_TYPE_MIDI_JACK)
-        port_gradient.setColorAt(pos2, m_lineSelected ? canvas.theme->line_midi_jack_sel : canvas.theme->line_midi_jack);
-    else if (port_type2 == PORT_TYPE_MIDI_A2J)
-        port_gradient.setColorAt(pos2, m_lineSelected ? canvas.theme->line_midi_a2j_sel : canvas.theme->line_midi_a2j);
-    else if (port_type2 == PORT_TYPE_MIDI_ALSA)
-        port_gradient.setColorAt(pos2, m_lineSelected ? canvas.theme->line_midi_alsa_sel : canvas.theme->line_midi_alsa);
-
-    setPen(QPen(port_gradient, 2));
+    setPen(pen);
+}
+
+QRectF CanvasLine::boundingRect() const
+{
+    // Leave room for the glow stroke of selected lines
+    if (options.eyecandy == EYECANDY_FULL)
+        return QGraphicsLineItem::boundingRect().adjusted(-3, -3, 3, 3);
+
+    return QGraphicsLineItem::boundingRect();
 }
 
 void CanvasLine::paint(QPainter* painter, const QStyleOptionGraphicsItem* option, QWidget* widget)
 {
-    painter->setRenderHint(QPainter::Antialiasing, bool(options.antialiasing));
+    painter->setRenderHint(QPainter::Antialiasing, bool(options.antialiasing) && canvas.detail_level != DETAIL_LOW);
+
+    if (m_lineSelected && options.eyecandy == EYECANDY_FULL && canvas.detail_level == DETAIL_FULL)
+    {
+        painter->setPen(canvas.theme->getLineGlowPen(item1->getPortType()));
+        painter->drawLine(line());
+    }
+
     QGraphicsLineItem::paint(painter, option, widget);
 }
 
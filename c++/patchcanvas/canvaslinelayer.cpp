@@ -0,0 +1,276 @@
+/*
+ * Patchbay Canvas engine using QGraphicsView/Scene
+ * Copyright (C) 2010-2012 Filipe Coelho <falktx@falktx.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * For a full copy of the GNU General Public License see the COPYING file
+ */
+
+#include "canvaslinelayer.h"
+
+#include <QtGui/QPainter>
+#include <QtGui/QPainterPathStroker>
+#include <QtGui/QStyleOptionGraphicsItem>
+
+#include "canvasbox.h"
+#include "canvaslayerline.h"
+#include "patchcanvas-theme.h"
+
+START_NAMESPACE_PATCHCANVAS
+
+CanvasLineLayer::CanvasLineLayer(QGraphicsItem* parent) :
+    QGraphicsItem(parent, canvas.scene)
+{
+    setAcceptedMouseButtons(Qt::NoButton);
+    setFlag(QGraphicsItem::ItemUsesExtendedStyleOption);
+}
+
+CanvasLineLayer::~CanvasLineLayer()
+{
+}
+
+int CanvasLineLayer::addLine(CanvasLayerLine* line, PortType port_type1, PortType port_type2)
+{
+    layer_line_t layer_line;
+    layer_line.line = line;
+    layer_line.port_type1 = port_type1;
+    layer_line.port_type2 = port_type2;
+    layer_line.selected = false;
+
+    m_lines.append(layer_line);
+    return m_lines.count()-1;
+}
+
+void CanvasLineLayer::removeLine(int index)
+{
+    if (index < 0 || index >= m_lines.count())
+        return;
+
+    update(m_lines[index].bounds);
+
+    // Move the last line into the free slot to keep the array compact
+    int last = m_lines.count()-1;
+    if (index != last)
+    {
+        m_lines[index] = m_lines[last];
+        m_lines[index].line->setLayerIndex(index);
+    }
+    m_lines.resize(last);
+
+    if (m_lines.isEmpty())
+    {
+        prepareGeometryChange();
+        m_bounds = QRectF();
+    }
+}
+
+void CanvasLineLayer::setLinePos(int index, const QPointF& pos1, const QPointF& pos2)
+{
+    layer_line_t& line = m_lines[index];
+
+    if (!line.bounds.isNull() && line.pos1 == pos1 && line.pos2 == pos2)
+        return;
+
+    QRectF bounds = getLineBounds(pos1, pos2);
+
+    // Only grow, shrinking would move the layer in the scene index on every drag step
+    if (!m_bounds.contains(bounds))
+    {
+        prepareGeometryChange();
+        m_bounds |= bounds;
+    }
+
+    update(line.bounds);
+    update(bounds);
+
+    line.pos1 = pos1;
+    line.pos2 = pos2;
+    line.bounds = bounds;
+    line.selected = false;
+}
+
+bool CanvasLineLayer::isLineSelected(int index) const
+{
+    return m_lines[index].selected;
+}
+
+void CanvasLineLayer::setLineSelected(int index, bool yesno)
+{
+    layer_line_t& line = m_lines[index];
+
+    if (line.selected == yesno)
+        return;
+
+    line.selected = yesno;
+    update(line.bounds);
+}
+
+void CanvasLineLayer::updateZValue()
+{
+    qreal top_z = 0;
+    bool has_box = false;
+
+    foreach (const group_dict_t& group, canvas.group_list)
+    {
+        for (int i=0; i < 2; i++)
+        {
+            if (CanvasBox* box = group.widgets[i])
+            {
+                top_z   = has_box ? qMax(top_z, box->zValue()) : box->zValue();
+                has_box = true;
+            }
+        }
+    }
+
+    setZValue(top_z-0.5);
+}
+
+void CanvasLineLayer::boxZValueChanged(qreal z)
+{
+    // Only a box raised over the layer becomes the new top, lowering goes through updateZValue()
+    if (z > zValue())
+        setZValue(z-0.5);
+}
+
+CanvasLayerLine* CanvasLineLayer::lineAt(const QPointF& pos) const
+{
+    // Latest lines are on top
+    for (int i=m_lines.count()-1; i >= 0; i--)
+    {
+        if (lineContains(m_lines[i], pos))
+            return m_lines[i].line;
+    }
+
+    return 0;
+}
+
+int CanvasLineLayer::type() const
+{
+    return CanvasLineLayerType;
+}
+
+bool CanvasLineLayer::contains(const QPointF& point) const
+{
+    return bool(lineAt(point));
+}
+
+QRectF CanvasLineLayer::getLineBounds(const QPointF& pos1, const QPointF& pos2)
+{
+    QRectF bounds = QRectF(pos1, pos2).normalized();
+
+    // Backwards bezier lines bulge out horizontally, the curve stays within its control points
+    if (options.use_bezier_lines && pos1.x() > pos2.x())
+    {
+        qreal mid_x = (pos1.x()-pos2.x())/2;
+        bounds.adjust(-mid_x, 0, mid_x, 0);
+    }
+
+    // Pen width plus the glow of selected lines
+    return bounds.adjusted(-4, -4, 4, 4);
+}
+
+void CanvasLineLayer::addLineToPath(QPainterPath& path, const QPointF& pos1, const QPointF& pos2)
+{
+    path.moveTo(pos1);
+
+    if (options.use_bezier_lines && canvas.detail_level != DETAIL_LOW)
+    {
+        qreal mid_x = qAbs(pos1.x()-pos2.x())/2;
+        path.cubicTo(pos1.x()+mid_x, pos1.y(), pos2.x()-mid_x, pos2.y(), pos2.x(), pos2.y());
+    }
+    else
+        path.lineTo(pos2);
+}
+
+bool CanvasLineLayer::lineContains(const layer_line_t& line, const QPointF& pos)
+{
+    if (line.bounds.isNull() || !line.bounds.adjusted(-2, -2, 2, 2).contains(pos))
+        return false;
+
+    QPainterPath path;
+    addLineToPath(path, line.pos1, line.pos2);
+
+    QPainterPathStroker stroker;
+    stroker.setWidth(8);
+
+    return stroker.createStroke(path).contains(pos);
+}
+
+QRectF CanvasLineLayer::boundingRect() const
+{
+    return m_bounds;
+}
+
+void CanvasLineLayer::paint(QPainter* painter, const QStyleOptionGraphicsItem* option, QWidget* widget)
+{
+    Q_UNUSED(widget);
+
+    painter->setRenderHint(QPainter::Antialiasing, bool(options.antialiasing) && canvas.detail_level != DETAIL_LOW);
+    painter->setBrush(Qt::NoBrush);
+
+    // Lines between ports of the same type share a solid pen, draw them with one path per pen
+    QPainterPath solid_paths[PORT_TYPE_MIDI_ALSA+1][2];
+
+    foreach (const layer_line_t& line, m_lines)
+    {
+        if (line.bounds.isNull() || !line.bounds.intersects(option->exposedRect))
+            continue;
+
+        if (line.selected && options.eyecandy == EYECANDY_FULL && canvas.detail_level == DETAIL_FULL)
+        {
+            QPainterPath glow_path;
+            addLineToPath(glow_path, line.pos1, line.pos2);
+
+            painter->setPen(canvas.theme->getLineGlowPen(line.port_type1));
+            painter->drawPath(glow_path);
+        }
+
+        if (line.port_type1 == line.port_type2)
+        {
+            addLineToPath(solid_paths[line.port_type1][line.selected ? 1 : 0], line.pos1, line.pos2);
+            continue;
+        }
+
+        QPen pen;
+        if (line.pos2.y() >= line.pos1.y())
+            pen = canvas.theme->getLinePen(line.port_type1, line.port_type2, line.selected);
+        else
+            pen = canvas.theme->getLinePen(line.port_type2, line.port_type1, line.selected);
+
+        if (pen.brush().gradient())
+        {
+            QBrush brush(pen.brush());
+            brush.setTransform(Theme::getLineBrushTransform(line.bounds.top(), line.bounds.bottom()));
+            pen.setBrush(brush);
+        }
+
+        QPainterPath path;
+        addLineToPath(path, line.pos1, line.pos2);
+
+        painter->setPen(pen);
+        painter->drawPath(path);
+    }
+
+    for (int i=PORT_TYPE_NULL; i <= PORT_TYPE_MIDI_ALSA; i++)
+    {
+        for (int j=0; j < 2; j++)
+        {
+            if (solid_paths[i][j].isEmpty())
+                continue;
+
+            painter->setPen(canvas.theme->getLinePen(static_cast<PortType>(i), static_cast<PortType>(i), j));
+            painter->drawPath(solid_paths[i][j]);
+        }
+    }
+}
+
+END_NAMESPACE_PATCHCANVAS
@@ -0,0 +1,81 @@
+/*
+ * Patchbay Canvas engine using QGraphicsView/Scene
+ * Copyright (C) 2010-2012 Filipe Coelho <falktx@falktx.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * For a full copy of the GNU General Public License see the COPYING file
+ */
+
+#ifndef CANVASLINELAYER_H
+#define CANVASLINELAYER_H
+
+#include <QtCore/QVector>
+#include <QtGui/QGraphicsItem>
+
+#include "patchcanvas.h"
+
+class QPainter;
+class QPainterPath;
+
+START_NAMESPACE_PATCHCANVAS
+
+class CanvasLayerLine;
+
+// Draws every connection of the canvas as a single scene item
+class CanvasLineLayer : public QGraphicsItem
+{
+public:
+    CanvasLineLayer(QGraphicsItem* parent);
+    ~CanvasLineLayer();
+
+    int addLine(CanvasLayerLine* line, PortType port_type1, PortType port_type2);
+    void removeLine(int index);
+
+    void setLinePos(int index, const QPointF& pos1, const QPointF& pos2);
+
+    bool isLineSelected(int index) const;
+    void setLineSelected(int index, bool yesno);
+
+    // Keeps the layer just below the top box, lines cannot be stacked one by one like in per-line mode
+    void updateZValue();
+    void boxZValueChanged(qreal z);
+
+    CanvasLayerLine* lineAt(const QPointF& pos) const;
+
+    virtual int type() const;
+    virtual bool contains(const QPointF& point) const;
+
+private:
+    struct layer_line_t {
+        CanvasLayerLine* line;
+        QPointF pos1;
+        QPointF pos2;
+        QRectF bounds;
+        PortType port_type1;
+        PortType port_type2;
+        bool selected;
+    };
+
+    QVector<layer_line_t> m_lines;
+    QRectF m_bounds;
+
+    static QRectF getLineBounds(const QPointF& pos1, const QPointF& pos2);
+    static void addLineToPath(QPainterPath& path, const QPointF& pos1, const QPointF& pos2);
+    static bool lineContains(const layer_line_t& line, const QPointF& pos);
+
+    virtual QRectF boundingRect() const;
+    virtual void paint(QPainter* painter, const QStyleOptionGraphicsItem* option, QWidget* widget);
+};
+
+END_NAMESPACE_PATCHCANVAS
+
+#endif // CANVASLINELAYER_H
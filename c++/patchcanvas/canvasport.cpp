@@ -40,19 +40,37 @@ CanvasPort::CanvasPort(int port_id, QString port_name, PortMode port_mode, PortT
     m_port_type = port_type;
     m_port_name = port_name;
 
+    // Keep search highlights when the item is created again, on split or join
+    m_highlighted = (port_id >= 0 && canvas.highlighted_ports.contains(port_id));
+
     // Base Variables
     m_port_width  = 15;
     m_port_height = 15;
     m_port_font   = QFont(canvas.theme->port_font_name, canvas.theme->port_font_size, canvas.theme->port_font_state);
 
+    m_port_text.setPerformanceHint(QStaticText::AggressiveCaching);
+    m_port_text.setTextFormat(Qt::PlainText);
+    m_port_text.setText(m_port_name);
+    m_port_text.prepare(QTransform(), m_port_font);
+
     m_line_mov   = 0;
     m_hover_item = 0;
-    m_last_selected_state = false;
 
     m_mouse_down    = false;
     m_cursor_moving = false;
 
-    setFlags(QGraphicsItem::ItemIsSelectable);
+    // Summary ports of collapsed boxes (negative id) only stand in for the real ones,
+    // they cannot be selected or connected and leave mouse events to the box
+    if (m_port_id >= 0)
+        setFlags(QGraphicsItem::ItemIsSelectable);
+
+    if (options.use_item_cache)
+        setCacheMode(QGraphicsItem::DeviceCoordinateCache);
+}
+
+CanvasPort::~CanvasPort()
+{
+    CanvasCancelItemFX(this);
 }
 
 int CanvasPort::getPortId()
@@ -104,22 +122,42 @@ void CanvasPort::setPortType(PortType port_type)
 
 void CanvasPort::setPortName(QString port_name)
 {
-    if (QFontMetrics(m_port_font).width(port_name) < QFontMetrics(m_port_font).width(m_port_name))
-        QTimer::singleShot(0, canvas.scene, SLOT(update()));
+    if (canvas.theme->getTextWidth(m_port_font, port_name) < canvas.theme->getTextWidth(m_port_font, m_port_name))
+        CanvasQueueSceneUpdate();
 
     m_port_name = port_name;
+    m_port_text.setText(m_port_name);
+    m_port_text.prepare(QTransform(), m_port_font);
     update();
 }
 
 void CanvasPort::setPortWidth(int port_width)
 {
+    if (port_width == m_port_width)
+        return;
+
     if (port_width < m_port_width)
-        QTimer::singleShot(0, canvas.scene, SLOT(update()));
+        CanvasQueueSceneUpdate();
 
+    prepareGeometryChange();
     m_port_width = port_width;
     update();
 }
 
+bool CanvasPort::isHighlighted()
+{
+    return m_highlighted;
+}
+
+void CanvasPort::setHighlighted(bool highlighted)
+{
+    if (highlighted == m_highlighted)
+        return;
+
+    m_highlighted = highlighted;
+    update();
+}
+
 int CanvasPort::type() const
 {
     return CanvasPortType;
@@ -128,7 +166,7 @@ int CanvasPort::type() const
 void CanvasPort::mousePressEvent(QGraphicsSceneMouseEvent* event)
 {
     m_hover_item = 0;
-    m_mouse_down = (event->button() == Qt::LeftButton);
+    m_mouse_down = (event->button() == Qt::LeftButton && m_port_id >= 0);
     m_cursor_moving = false;
     QGraphicsItem::mousePressEvent(event);
 }
@@ -142,10 +180,10 @@ void CanvasPort::mouseMoveEvent(QGraphicsSceneMouseEvent* event)
             setCursor(QCursor(Qt::CrossCursor));
             m_cursor_moving = true;
 
-            foreach (const connection_dict_t& connection, canvas.connection_list)
+            foreach (const int& connection_id, CanvasGetPortConnectionList(m_port_id))
             {
-                if (connection.port_out_id == m_port_id || connection.port_in_id == m_port_id)
-                    connection.widget->setLocked(true);
+                if (const connection_dict_t* connection = CanvasGetConnection(connection_id))
+                    connection->widget->setLocked(true);
             }
         }
 
@@ -168,7 +206,7 @@ void CanvasPort::mouseMoveEvent(QGraphicsSceneMouseEvent* event)
         {
             if (items[i]->type() == CanvasPortType)
             {
-                if (items[i] != this)
+                if (items[i] != this && ((CanvasPort*)items[i])->getPortId() >= 0)
                 {
                     if (! item)
                         item = (CanvasPort*)items[i];
@@ -212,21 +250,22 @@ void CanvasPort::mouseReleaseEvent(QGraphicsSceneMouseEvent* event)
             m_line_mov = 0;
         }
 
-        foreach (const connection_dict_t& connection, canvas.connection_list)
+        QList<int> port_con_list = CanvasGetPortConnectionList(m_port_id);
+
+        foreach (const int& connection_id, port_con_list)
         {
-            if (connection.port_out_id == m_port_id || connection.port_in_id == m_port_id)
-                connection.widget->setLocked(false);
+            if (const connection_dict_t* connection = CanvasGetConnection(connection_id))
+                connection->widget->setLocked(false);
         }
 
         if (m_hover_item)
         {
             bool check = false;
-            foreach (const connection_dict_t& connection, canvas.connection_list)
+            foreach (const int& connection_id, port_con_list)
             {
-                if ( (connection.port_out_id == m_port_id && connection.port_in_id == m_hover_item->getPortId()) ||
-                     (connection.port_out_id == m_hover_item->getPortId() && connection.port_in_id == m_port_id) )
+                if (CanvasGetConnectedPort(connection_id, m_port_id) == m_hover_item->getPortId())
                 {
-                    canvas.callback(ACTION_PORTS_DISCONNECT, connection.connection_id, 0, "");
+                    canvas.callback(ACTION_PORTS_DISCONNECT, connection_id, 0, "");
                     check = true;
                     break;
                 }
@@ -255,6 +294,9 @@ void CanvasPort::mouseReleaseEvent(QGraphicsSceneMouseEvent* event)
 
 void CanvasPort::contextMenuEvent(QGraphicsSceneContextMenuEvent* event)
 {
+    if (m_port_id < 0)
+        return event->ignore();
+
     canvas.scene->clearSelection();
     setSelected(true);
 
@@ -318,6 +360,24 @@ void CanvasPort::contextMenuEvent(QGraphicsSceneContextMenuEvent* event)
     event->accept();
 }
 
+QVariant CanvasPort::itemChange(GraphicsItemChange change, const QVariant& value)
+{
+    // Highlight lines here, paint() may be served from cache and never run
+    if (change == QGraphicsItem::ItemSelectedHasChanged)
+    {
+        if (const port_dict_t* port = CanvasGetPort(m_port_id))
+        {
+            foreach (const int& connection_id, port->connection_ids)
+            {
+                if (const connection_dict_t* connection = CanvasGetConnection(connection_id))
+                    connection->widget->setLineSelected(value.toBool());
+            }
+        }
+    }
+
+    return QGraphicsItem::itemChange(change, value);
+}
+
 QRectF CanvasPort::boundingRect() const
 {
     return QRectF(0, 0, m_port_width+12, m_port_height);
@@ -325,7 +385,7 @@ QRectF CanvasPort::boundingRect() const
 
 void CanvasPort::paint(QPainter* painter, const QStyleOptionGraphicsItem* /*option*/, QWidget* /*widget*/)
 {
-    painter->setRenderHint(QPainter::Antialiasing, (options.antialiasing == ANTIALIASING_FULL));
+    painter->setRenderHint(QPainter::Antialiasing, (options.antialiasing == ANTIALIASING_FULL && canvas.detail_level == DETAIL_FULL));
 
     QPointF text_pos;
     int poly_locx[5] = { 0 };
@@ -391,25 +451,28 @@ void CanvasPort::paint(QPainter* painter, const QStyleOptionGraphicsItem* /*opti
     QColor poly_color;
     QPen poly_pen;
 
+    // Search matches use the selected colors plus an outline
+    bool selected = (isSelected() || m_highlighted);
+
     if (m_port_type == PORT_TYPE_AUDIO_JACK)
     {
-        poly_color = isSelected() ? canvas.theme->port_audio_jack_bg_sel : canvas.theme->port_audio_jack_bg;
-        poly_pen = isSelected() ? canvas.theme->port_audio_jack_pen_sel : canvas.theme->port_audio_jack_pen;
+        poly_color = selected ? canvas.theme->port_audio_jack_bg_sel : canvas.theme->port_audio_jack_bg;
+        poly_pen = selected ? canvas.theme->port_audio_jack_pen_sel : canvas.theme->port_audio_jack_pen;
     }
     else if (m_port_type == PORT_TYPE_MIDI_JACK)
     {
-        poly_color = isSelected() ? canvas.theme->port_midi_jack_bg_sel : canvas.theme->port_midi_jack_bg;
-        poly_pen = isSelected() ? canvas.theme->port_midi_jack_pen_sel : canvas.theme->port_midi_jack_pen;
+        poly_color = selected ? canvas.theme->port_midi_jack_bg_sel : canvas.theme->port_midi_jack_bg;
+        poly_pen = selected ? canvas.theme->port_midi_jack_pen_sel : canvas.theme->port_midi_jack_pen;
     }
     else if (m_port_type == PORT_TYPE_MIDI_A2J)
     {
-        poly_color = isSelected() ? canvas.theme->port_midi_a2j_bg_sel : canvas.theme->port_midi_a2j_bg;
-        poly_pen = isSelected() ? canvas.theme->port_midi_a2j_pen_sel : canvas.theme->port_midi_a2j_pen;
+        poly_color = selected ? canvas.theme->port_midi_a2j_bg_sel : canvas.theme->port_midi_a2j_bg;
+        poly_pen = selected ? canvas.theme->port_midi_a2j_pen_sel : canvas.theme->port_midi_a2j_pen;
     }
     else if (m_port_type == PORT_TYPE_MIDI_ALSA)
     {
-        poly_color = isSelected() ? canvas.theme->port_midi_alsa_bg_sel : canvas.theme->port_midi_alsa_bg;
-        poly_pen = isSelected() ? canvas.theme->port_midi_alsa_pen_sel : canvas.theme->port_midi_alsa_pen;
+        poly_color = selected ? canvas.theme->port_midi_alsa_bg_sel : canvas.theme->port_midi_alsa_bg;
+        poly_pen = selected ? canvas.theme->port_midi_alsa_pen_sel : canvas.theme->port_midi_alsa_pen;
     }
     else
     {
@@ -417,31 +480,37 @@ void CanvasPort::paint(QPainter* painter, const QStyleOptionGraphicsItem* /*opti
         return;
     }
 
-    QPolygonF polygon;
-    polygon += QPointF(poly_locx[0], 0);
-    polygon += QPointF(poly_locx[1], 0);
-    polygon += QPointF(poly_locx[2], 7.5);
-    polygon += QPointF(poly_locx[3], 15);
-    polygon += QPointF(poly_locx[4], 15);
-
-    painter->setBrush(poly_color);
-    painter->setPen(poly_pen);
-    painter->drawPolygon(polygon);
-
-    painter->setPen(canvas.theme->port_text);
-    painter->setFont(m_port_font);
-    painter->drawText(text_pos, m_port_name);
+    if (canvas.detail_level == DETAIL_LOW)
+    {
+        painter->fillRect(QRectF(0, 0, m_port_width+12, 15), poly_color);
+    }
+    else
+    {
+        QPolygonF polygon;
+        polygon += QPointF(poly_locx[0], 0);
+        polygon += QPointF(poly_locx[1], 0);
+        polygon += QPointF(poly_locx[2], 7.5);
+        polygon += QPointF(poly_locx[3], 15);
+        polygon += QPointF(poly_locx[4], 15);
+
+        painter->setBrush(poly_color);
+        painter->setPen(poly_pen);
+        painter->drawPolygon(polygon);
+    }
 
-    if (isSelected() != m_last_selected_state)
+    if (m_highlighted)
     {
-        foreach (const connection_dict_t& connection, canvas.connection_list)
-        {
-            if (connection.port_out_id == m_port_id || connection.port_in_id == m_port_id)
-                connection.widget->setLineSelected(isSelected());
-        }
+        painter->setBrush(Qt::NoBrush);
+        painter->setPen(canvas.theme->rubberband_pen);
+        painter->drawRect(QRectF(0.5, 0.5, m_port_width+11, 14));
     }
 
-    m_last_selected_state = isSelected();
+    if (canvas.detail_level == DETAIL_FULL)
+    {
+        painter->setPen(canvas.theme->port_text);
+        painter->setFont(m_port_font);
+        painter->drawStaticText(text_pos-QPointF(0, canvas.theme->getTextAscent(m_port_font)), m_port_text);
+    }
 }
 
 END_NAMESPACE_PATCHCANVAS
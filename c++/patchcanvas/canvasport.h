@@ -18,6 +18,8 @@
 #ifndef CANVASPORT_H
 #define CANVASPORT_H
 
+#include <QtGui/QStaticText>
+
 #include "patchcanvas.h"
 
 class QGraphicsSceneContextMenuEvent;
@@ -32,6 +34,7 @@ class CanvasPort : public QGraphicsItem
 {
 public:
     CanvasPort(int port_id, QString port_name, PortMode port_mode, PortType port_type, QGraphicsItem* parent);
+    ~CanvasPort();
 
     int getPortId();
     PortMode getPortMode();
@@ -46,6 +49,9 @@ public:
     void setPortName(QString port_name);
     void setPortWidth(int port_width);
 
+    bool isHighlighted();
+    void setHighlighted(bool highlighted);
+
     virtual int type() const;
 
 private:
@@ -54,13 +60,15 @@ private:
     PortType m_port_type;
     QString m_port_name;
 
+    bool m_highlighted;
+
     int m_port_width;
     int m_port_height;
     QFont m_port_font;
+    QStaticText m_port_text;
 
     AbstractCanvasLineMov* m_line_mov;
     CanvasPort* m_hover_item;
-    bool m_last_selected_state;
 
     bool m_mouse_down;
     bool m_cursor_moving;
@@ -70,6 +78,8 @@ private:
     virtual void mouseReleaseEvent(QGraphicsSceneMouseEvent* event);
     virtual void contextMenuEvent(QGraphicsSceneContextMenuEvent* event);
 
+    virtual QVariant itemChange(GraphicsItemChange change, const QVariant& value);
+
     virtual QRectF boundingRect() const;
     virtual void paint(QPainter* painter, const QStyleOptionGraphicsItem* option, QWidget* widget);
 };
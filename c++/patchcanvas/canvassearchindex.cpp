@@ -0,0 +1,228 @@
+/*
+ * Patchbay Canvas engine using QGraphicsView/Scene
+ * Copyright (C) 2010-2012 Filipe Coelho <falktx@falktx.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * For a full copy of the GNU General Public License see the COPYING file
+ */
+
+
+#include "canvassearchindex.h"
+
+#include <QtCore/QRegExp>
+#include <QtCore/QStringList>
+
+START_NAMESPACE_PATCHCANVAS
+
+static const int SEARCH_GRAM_SIZE = 3;
+
+static bool CanvasSearchListLessThan(const QSet<int>* list1, const QSet<int>* list2)
+{
+    return list1->count() < list2->count();
+}
+
+CanvasSearchIndex::CanvasSearchIndex()
+{
+}
+
+void CanvasSearchIndex::setGroupName(int group_id, const QString& group_name)
+{
+    m_group_names.insert(group_id, group_name);
+
+    // The group name is part of the text of all its ports
+    foreach (const int& port_id, m_group_ports.value(group_id))
+    {
+        entry_t& entry = m_entries[port_id];
+        unindexEntry(port_id, entry);
+        entry.text = entryText(group_name, entry.port_name);
+        indexEntry(port_id, entry);
+    }
+}
+
+void CanvasSearchIndex::removeGroup(int group_id)
+{
+    foreach (const int& port_id, m_group_ports.value(group_id))
+    {
+        unindexEntry(port_id, m_entries.value(port_id));
+        m_entries.remove(port_id);
+    }
+
+    m_group_ports.remove(group_id);
+    m_group_names.remove(group_id);
+}
+
+void CanvasSearchIndex::addPort(int port_id, int group_id, const QString& port_name)
+{
+    if (m_entries.contains(port_id))
+        removePort(port_id);
+
+    entry_t entry;
+    entry.group_id  = group_id;
+    entry.port_name = port_name;
+    entry.text = entryText(m_group_names.value(group_id), port_name);
+
+    m_entries.insert(port_id, entry);
+    m_group_ports[group_id].insert(port_id);
+    indexEntry(port_id, entry);
+}
+
+void CanvasSearchIndex::renamePort(int port_id, const QString& port_name)
+{
+    QHash<int, entry_t>::iterator it = m_entries.find(port_id);
+
+    if (it == m_entries.end())
+        return;
+
+    unindexEntry(port_id, it.value());
+    it.value().port_name = port_name;
+    it.value().text = entryText(m_group_names.value(it.value().group_id), port_name);
+    indexEntry(port_id, it.value());
+}
+
+void CanvasSearchIndex::removePort(int port_id)
+{
+    QHash<int, entry_t>::iterator it = m_entries.find(port_id);
+
+    if (it == m_entries.end())
+        return;
+
+    unindexEntry(port_id, it.value());
+
+    QHash<int, QSet<int> >::iterator git = m_group_ports.find(it.value().group_id);
+    if (git != m_group_ports.end())
+    {
+        git.value().remove(port_id);
+        if (git.value().isEmpty())
+            m_group_ports.erase(git);
+    }
+
+    m_entries.erase(it);
+}
+
+void CanvasSearchIndex::clear()
+{
+    m_entries.clear();
+    m_group_names.clear();
+    m_group_ports.clear();
+    m_grams.clear();
+}
+
+QList<int> CanvasSearchIndex::search(const QString& text) const
+{
+    QStringList words = text.toLower().split(QRegExp("\\s+"), QString::SkipEmptyParts);
+
+    if (words.isEmpty())
+        return QList<int>();
+
+    QSet<int> result;
+    bool first = true;
+
+    foreach (const QString& word, words)
+    {
+        // Posting lists of all n-grams of the word, a missing one means no match at all
+        int size = qMin(SEARCH_GRAM_SIZE, word.length());
+        QList<const QSet<int>*> lists;
+
+        for (int i=0; i+size <= word.length(); i++)
+        {
+            QHash<quint64, QSet<int> >::const_iterator it = m_grams.constFind(gramKey(word.constData()+i, size));
+
+            if (it == m_grams.constEnd())
+                return QList<int>();
+
+            lists.append(&it.value());
+        }
+
+        // Walk the shortest list and only probe the others
+        qSort(lists.begin(), lists.end(), CanvasSearchListLessThan);
+
+        QSet<int> matches;
+
+        foreach (const int& port_id, *lists[0])
+        {
+            if (!first && !result.contains(port_id))
+                continue;
+
+            bool found = true;
+
+            for (int i=1; i < lists.count() && found; i++)
+                found = lists[i]->contains(port_id);
+
+            // Longer words can share all n-grams with a text that does not contain them
+            if (found && word.length() > SEARCH_GRAM_SIZE)
+                found = m_entries.value(port_id).text.contains(word);
+
+            if (found)
+                matches.insert(port_id);
+        }
+
+        if (matches.isEmpty())
+            return QList<int>();
+
+        result = matches;
+        first  = false;
+    }
+
+    QList<int> port_ids = result.toList();
+    qSort(port_ids);
+    return port_ids;
+}
+
+void CanvasSearchIndex::indexEntry(int port_id, const entry_t& entry)
+{
+    const QString& text = entry.text;
+
+    for (int i=0; i < text.length(); i++)
+    {
+        for (int size=1; size <= SEARCH_GRAM_SIZE && i+size <= text.length(); size++)
+            m_grams[gramKey(text.constData()+i, size)].insert(port_id);
+    }
+}
+
+void CanvasSearchIndex::unindexEntry(int port_id, const entry_t& entry)
+{
+    const QString& text = entry.text;
+
+    for (int i=0; i < text.length(); i++)
+    {
+        for (int size=1; size <= SEARCH_GRAM_SIZE && i+size <= text.length(); size++)
+        {
+            QHash<quint64, QSet<int> >::iterator it = m_grams.find(gramKey(text.constData()+i, size));
+
+            if (it == m_grams.end())
+                continue;
+
+            it.value().remove(port_id);
+            if (it.value().isEmpty())
+                m_grams.erase(it);
+        }
+    }
+}
+
+QString CanvasSearchIndex::entryText(const QString& group_name, const QString& port_name)
+{
+    // Same form as CanvasGetFullPortName(), so full names can be searched too
+    return QString("%1:%2").arg(group_name, port_name).toLower();
+}
+
+quint64 CanvasSearchIndex::gramKey(const QChar* chars, int count)
+{
+    // Length in the top bits, up to 3 UTF-16 units below
+    quint64 key = quint64(count) << 48;
+
+    for (int i=0; i < count; i++)
+        key |= quint64(chars[i].unicode()) << (16*(2-i));
+
+    return key;
+}
+
+END_NAMESPACE_PATCHCANVAS
@@ -0,0 +1,72 @@
+/*
+ * Patchbay Canvas engine using QGraphicsView/Scene
+ * Copyright (C) 2010-2012 Filipe Coelho <falktx@falktx.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * For a full copy of the GNU General Public License see the COPYING file
+ */
+
+
+#ifndef CANVASSEARCHINDEX_H
+#define CANVASSEARCHINDEX_H
+
+#include <QtCore/QHash>
+#include <QtCore/QList>
+#include <QtCore/QSet>
+#include <QtCore/QString>
+
+#include "patchcanvas.h"
+
+START_NAMESPACE_PATCHCANVAS
+
+// N-gram index over the "group:port" names of all ports, case insensitive.
+// Every substring of up to 3 characters maps to the ports containing it,
+// so queries only walk the shortest matching list instead of all ports.
+class CanvasSearchIndex
+{
+public:
+    CanvasSearchIndex();
+
+    void setGroupName(int group_id, const QString& group_name);
+    void removeGroup(int group_id);
+
+    void addPort(int port_id, int group_id, const QString& port_name);
+    void renamePort(int port_id, const QString& port_name);
+    void removePort(int port_id);
+
+    void clear();
+
+    // Ports matching every whitespace separated word of text, sorted by id
+    QList<int> search(const QString& text) const;
+
+private:
+    struct entry_t {
+        int group_id;
+        QString port_name;
+        QString text;
+    };
+
+    QHash<int, entry_t> m_entries;
+    QHash<int, QString> m_group_names;
+    QHash<int, QSet<int> > m_group_ports;
+    QHash<quint64, QSet<int> > m_grams;
+
+    void indexEntry(int port_id, const entry_t& entry);
+    void unindexEntry(int port_id, const entry_t& entry);
+
+    static QString entryText(const QString& group_name, const QString& port_name);
+    static quint64 gramKey(const QChar* chars, int count);
+};
+
+END_NAMESPACE_PATCHCANVAS
+
+#endif // CANVASSEARCHINDEX_H
@@ -17,6 +17,11 @@
 
 #include "patchcanvas-theme.h"
 
+#include <cmath>
+#include <QtGui/QFontMetrics>
+#include <QtGui/QImage>
+#include <QtGui/QLinearGradient>
+
 START_NAMESPACE_PATCHCANVAS
 
 Theme::Theme(List id)
@@ -150,6 +155,164 @@ Theme::Theme(List id)
     default:
         break;
     }
+
+    updateLinePens();
+}
+
+void Theme::updateLinePens()
+{
+    for (int i=PORT_TYPE_NULL; i <= PORT_TYPE_MIDI_ALSA; i++)
+    {
+        QColor glow_color;
+
+        switch (i)
+        {
+        case PORT_TYPE_AUDIO_JACK:
+            glow_color = line_audio_jack_glow;
+            break;
+        case PORT_TYPE_MIDI_JACK:
+            glow_color = line_midi_jack_glow;
+            break;
+        case PORT_TYPE_MIDI_A2J:
+            glow_color = line_midi_a2j_glow;
+            break;
+        case PORT_TYPE_MIDI_ALSA:
+            glow_color = line_midi_alsa_glow;
+            break;
+        default:
+            glow_color = Qt::transparent;
+            break;
+        }
+
+        glow_color.setAlpha(110);
+        m_line_glow_pens[i] = QPen(glow_color, 7, Qt::SolidLine, Qt::RoundCap, Qt::RoundJoin);
+    }
+
+    for (int top=PORT_TYPE_NULL; top <= PORT_TYPE_MIDI_ALSA; top++)
+    {
+        for (int bottom=PORT_TYPE_NULL; bottom <= PORT_TYPE_MIDI_ALSA; bottom++)
+        {
+            for (int selected=0; selected < 2; selected++)
+            {
+                QColor color_top = getLineColor(static_cast<PatchCanvas::PortType>(top), selected);
+                QColor color_bot = getLineColor(static_cast<PatchCanvas::PortType>(bottom), selected);
+
+                if (!color_top.isValid())
+                    color_top = color_bot;
+                if (!color_bot.isValid())
+                    color_bot = color_top;
+
+                if (color_top == color_bot)
+                {
+                    m_line_pens[top][bottom][selected] = QPen(color_top, 2);
+                }
+                else
+                {
+                    QLinearGradient port_gradient(0, 0, 0, 1);
+                    port_gradient.setColorAt(0, color_top);
+                    port_gradient.setColorAt(1, color_bot);
+                    m_line_pens[top][bottom][selected] = QPen(port_gradient, 2);
+                }
+            }
+        }
+    }
+}
+
+const QPen& Theme::getLinePen(PatchCanvas::PortType top, PatchCanvas::PortType bottom, bool selected) const
+{
+    return m_line_pens[top][bottom][selected ? 1 : 0];
+}
+
+const QPen& Theme::getLineGlowPen(PatchCanvas::PortType port_type) const
+{
+    return m_line_glow_pens[port_type];
+}
+
+const QPixmap& Theme::getBoxShadowPixmap()
+{
+    if (!m_box_shadow.isNull())
+        return m_box_shadow;
+
+    const int radius = getBoxShadowRadius();
+    const int size   = radius*2+2;
+
+    QImage image(size, size, QImage::Format_ARGB32_Premultiplied);
+
+    // Smooth falloff from the 2x2 core outwards, close to a blurred rect
+    for (int y=0; y < size; y++)
+    {
+        QRgb* line = reinterpret_cast<QRgb*>(image.scanLine(y));
+
+        for (int x=0; x < size; x++)
+        {
+            qreal dx = qMax(qreal(0), qMax(radius-(x+0.5), (x+0.5)-(radius+2)));
+            qreal dy = qMax(qreal(0), qMax(radius-(y+0.5), (y+0.5)-(radius+2)));
+            qreal t  = qMin(qreal(1), std::sqrt(dx*dx+dy*dy)/radius);
+            qreal falloff = 1.0 - t*t*(3-2*t);
+
+            line[x] = qPremultiply(qRgba(box_shadow.red(), box_shadow.green(), box_shadow.blue(), qRound(box_shadow.alpha()*falloff*falloff)));
+        }
+    }
+
+    m_box_shadow = QPixmap::fromImage(image);
+    return m_box_shadow;
+}
+
+int Theme::getBoxShadowRadius() const
+{
+    return 12;
+}
+
+QTransform Theme::getLineBrushTransform(qreal top, qreal bottom)
+{
+    return QTransform(1, 0, 0, bottom-top, 0, top);
+}
+
+int Theme::getTextWidth(const QFont& font, const QString& text)
+{
+    QPair<QString, QString> key(font.key(), text);
+    QHash<QPair<QString, QString>, int>::const_iterator it = m_text_widths.find(key);
+
+    if (it != m_text_widths.end())
+        return it.value();
+
+    // Renames keep adding entries, start over instead of growing forever
+    if (m_text_widths.count() >= 8192)
+        m_text_widths.clear();
+
+    int width = QFontMetrics(font).width(text);
+    m_text_widths.insert(key, width);
+    return width;
+}
+
+int Theme::getTextAscent(const QFont& font)
+{
+    QString key = font.key();
+    QHash<QString, int>::const_iterator it = m_text_ascents.find(key);
+
+    if (it != m_text_ascents.end())
+        return it.value();
+
+    int ascent = QFontMetrics(font).ascent();
+    m_text_ascents.insert(key, ascent);
+    return ascent;
+}
+
+QColor Theme::getLineColor(PatchCanvas::PortType port_type, bool selected) const
+{
+    switch (port_type)
+    {
+    case PORT_TYPE_AUDIO_JACK:
+        return selected ? line_audio_jack_sel : line_audio_jack;
+    case PORT_TYPE_MIDI_JACK:
+        return selected ? line_midi_jack_sel : line_midi_jack;
+    case PORT_TYPE_MIDI_A2J:
+        return selected ? line_midi_a2j_sel : line_midi_a2j;
+    case PORT_TYPE_MIDI_ALSA:
+        return selected ? line_midi_alsa_sel : line_midi_alsa;
+    default:
+        return QColor();
+    }
 }
 
 Theme::List getDefaultTheme()
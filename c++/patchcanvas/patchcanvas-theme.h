@@ -18,9 +18,13 @@
 #ifndef PATCHCANVAS_THEME_H
 #define PATCHCANVAS_THEME_H
 
+#include <QtCore/QHash>
+#include <QtCore/QPair>
 #include <QtGui/QColor>
 #include <QtGui/QFont>
 #include <QtGui/QPen>
+#include <QtGui/QPixmap>
+#include <QtGui/QTransform>
 
 #include "../patchcanvas.h"
 
@@ -42,6 +46,25 @@ public:
 
     Theme(List id);
 
+    // Rebuild cached pens after changing any line color
+    void updateLinePens();
+
+    // Pen for a line whose top end is of type 'top' and bottom end of type 'bottom'.
+    // Gradients span the unit square, use getLineBrushTransform() to map them onto the line.
+    const QPen& getLinePen(PatchCanvas::PortType top, PatchCanvas::PortType bottom, bool selected) const;
+    static QTransform getLineBrushTransform(qreal top, qreal bottom);
+
+    // Wide translucent stroke drawn under selected lines
+    const QPen& getLineGlowPen(PatchCanvas::PortType port_type) const;
+
+    // Nine-slice box shadow, corners and edges are 'radius' pixels wide
+    const QPixmap& getBoxShadowPixmap();
+    int getBoxShadowRadius() const;
+
+    // Cached text metrics, shared by all boxes and ports using this theme
+    int getTextWidth(const QFont& font, const QString& text);
+    int getTextAscent(const QFont& font);
+
     // Canvas
     QString name;
 
@@ -95,6 +118,19 @@ public:
     QColor line_midi_alsa_glow;
     QPen rubberband_pen;
     QColor rubberband_brush;
+
+private:
+    QColor getLineColor(PatchCanvas::PortType port_type, bool selected) const;
+
+    // [top type][bottom type][selected]
+    QPen m_line_pens[PORT_TYPE_MIDI_ALSA+1][PORT_TYPE_MIDI_ALSA+1][2];
+    QPen m_line_glow_pens[PORT_TYPE_MIDI_ALSA+1];
+
+    QPixmap m_box_shadow;
+
+    // (font key, text) -> width
+    QHash<QPair<QString, QString>, int> m_text_widths;
+    QHash<QString, int> m_text_ascents;
 };
 
 END_NAMESPACE_PATCHCANVAS
@@ -18,45 +18,37 @@
 #include "patchcanvas.h"
 #include "patchscene.h"
 
+#include <QtCore/QDataStream>
+#include <QtCore/QFileInfo>
+#include <QtCore/QFutureWatcher>
+#include <QtCore/QSet>
 #include <QtCore/QSettings>
 #include <QtCore/QTimer>
+#include <QtCore/QtConcurrentRun>
 #include <QtGui/QAction>
 
-#include "canvasfadeanimation.h"
+#include "canvasarrange.h"
 #include "canvasline.h"
 #include "canvasbezierline.h"
+#include "canvaslayerline.h"
+#include "canvaslinelayer.h"
 #include "canvasport.h"
 #include "canvasbox.h"
+#include "canvasboxgrid.h"
+#include "canvascommandqueue.h"
+#include "canvaslayoutstore.h"
+#include "canvassearchindex.h"
 
 CanvasObject::CanvasObject(QObject* parent) : QObject(parent) {}
 
-void CanvasObject::AnimationIdle()
+void CanvasObject::AnimationTick()
 {
-    PatchCanvas::CanvasFadeAnimation* animation = (PatchCanvas::CanvasFadeAnimation*)sender();
-    if (animation)
-        PatchCanvas::CanvasRemoveAnimation(animation);
+    PatchCanvas::CanvasAnimationTick();
 }
 
-void CanvasObject::AnimationHide()
+void CanvasObject::DragTick()
 {
-    PatchCanvas::CanvasFadeAnimation* animation = (PatchCanvas::CanvasFadeAnimation*)sender();
-    if (animation)
-    {
-        if (animation->item())
-            animation->item()->hide();
-        PatchCanvas::CanvasRemoveAnimation(animation);
-    }
-}
-
-void CanvasObject::AnimationDestroy()
-{
-    PatchCanvas::CanvasFadeAnimation* animation = (PatchCanvas::CanvasFadeAnimation*)sender();
-    if (animation)
-    {
-        if (animation->item())
-            PatchCanvas::CanvasRemoveItemFX(animation->item());
-        PatchCanvas::CanvasRemoveAnimation(animation);
-    }
+    PatchCanvas::CanvasFlushDrag();
 }
 
 void CanvasObject::CanvasPostponedGroups()
@@ -72,25 +64,92 @@ void CanvasObject::PortContextMenuDisconnect()
         PatchCanvas::CanvasCallback(PatchCanvas::ACTION_PORTS_DISCONNECT, connection_id, 0, "");
 }
 
+void CanvasObject::ArrangeFinished()
+{
+    PatchCanvas::CanvasArrangeFinished();
+}
+
+void CanvasObject::LayoutSync()
+{
+    // Come back once more to fold the finished write into the mapped file
+    if (PatchCanvas::canvas.layout_store && PatchCanvas::canvas.layout_store->sync())
+        PatchCanvas::canvas.layout_timer->start();
+}
+
+void CanvasObject::CommandsPending()
+{
+    // Queued from a producer thread, wait for the rest of the frame to arrive
+    if (!PatchCanvas::canvas.command_timer)
+    {
+        PatchCanvas::canvas.command_timer = new QTimer(this);
+        PatchCanvas::canvas.command_timer->setSingleShot(true);
+        PatchCanvas::canvas.command_timer->setInterval(16);
+        connect(PatchCanvas::canvas.command_timer, SIGNAL(timeout()), SLOT(CommandTick()));
+    }
+
+    if (!PatchCanvas::canvas.command_timer->isActive())
+        PatchCanvas::canvas.command_timer->start();
+}
+
+void CanvasObject::CommandTick()
+{
+    PatchCanvas::CanvasProcessCommands();
+}
+
+void CanvasObject::SceneUpdate()
+{
+    PatchCanvas::canvas.scene_update_pending = false;
+
+    if (PatchCanvas::canvas.scene)
+        PatchCanvas::canvas.scene->update();
+}
+
 START_NAMESPACE_PATCHCANVAS
 
 /* contructor and destructor */
 Canvas::Canvas()
 {
+    scene     = 0;
     qobject   = 0;
     settings  = 0;
     theme     = 0;
+    layout_store = 0;
+    layout_timer = 0;
+    command_timer = 0;
     initiated = false;
+
+    update_depth = 0;
+    scene_dirty  = false;
+    scene_update_pending = false;
+    line_layer = 0;
+    animation_timer = 0;
+    drag_pending = false;
+    drag_timer   = 0;
+    suppress_fx  = false;
+    box_grid   = new CanvasBoxGrid();
+    command_queue = 0;
+    command_target = 0;
+    search_index  = new CanvasSearchIndex();
+    detail_level = DETAIL_FULL;
+    arrange_watcher = 0;
+    arrange_queued  = false;
+    arrange_queued_incremental = false;
 }
 
 Canvas::~Canvas()
 {
+    command_target.fetchAndStoreOrdered(0);
     if (qobject)
         delete qobject;
+    if (layout_store)
+        delete layout_store;
     if (settings)
         delete settings;
     if (theme)
         delete theme;
+    delete box_grid;
+    delete static_cast<CanvasCommandQueue*>(command_queue);
+    delete search_index;
 }
 
 /* Global objects */
@@ -101,7 +160,9 @@ options_t options = {
     /* auto_hide_groups */ false,
     /* use_bezier_lines */ true,
     /* antialiasing */     ANTIALIASING_SMALL,
-    /* eyecandy */         EYECANDY_SMALL
+    /* eyecandy */         EYECANDY_SMALL,
+    /* use_line_layer */   false,
+    /* use_item_cache */   true
 };
 
 features_t features = {
@@ -170,6 +231,207 @@ const char* split2str(SplitOption split)
         return "SPLIT_???";
 }
 
+/* Registry helpers */
+static int CanvasDictId(const group_dict_t& group)
+{
+    return group.group_id;
+}
+
+static int CanvasDictId(const port_dict_t& port)
+{
+    return port.port_id;
+}
+
+static int CanvasDictId(const connection_dict_t& connection)
+{
+    return connection.connection_id;
+}
+
+template<typename T>
+static void CanvasListAppend(QList<T>& list, QHash<int, int>& index, const T& dict)
+{
+    index.insert(CanvasDictId(dict), list.count());
+    list.append(dict);
+}
+
+// Removal swaps the last entry into the freed slot, so it costs O(1) but does not keep list order.
+// Nothing shown to the user may follow list order: boxes keep their own ordered port lists
+// and arrange() walks groups by id.
+template<typename T>
+static bool CanvasListTake(QList<T>& list, QHash<int, int>& index, int id)
+{
+    QHash<int, int>::iterator it = index.find(id);
+
+    if (it == index.end())
+        return false;
+
+    int i    = it.value();
+    int last = list.count()-1;
+    index.erase(it);
+
+    if (i != last)
+    {
+        list.swap(i, last);
+        index[CanvasDictId(list[i])] = i;
+    }
+
+    list.removeLast();
+    return true;
+}
+
+static bool CanvasAddPortInternal(int group_id, int port_id, const QString& port_name, PortMode port_mode, PortType port_type);
+static void CanvasConnectPortsInternal(int connection_id, port_dict_t* port_out_dict, port_dict_t* port_in_dict);
+static void CanvasAttachLine(connection_dict_t* connection, const port_dict_t* port_out_dict, const port_dict_t* port_in_dict, bool fade);
+static void CanvasDetachLine(const connection_dict_t* connection, const port_dict_t* port_out_dict, const port_dict_t* port_in_dict, bool fade);
+
+// Hands a port over to the other box of its group, the port item and its lines stay alive
+static void CanvasMovePort(const port_dict_t* port, CanvasBox* from_box, CanvasBox* to_box)
+{
+    from_box->removePortFromGroup(port->port_id);
+    to_box->attachPort(port);
+
+    // Collapsed boxes have no port items, the caller rebuilds their lines
+    if (!port->widget)
+        return;
+
+    // Each end of a line lists it in its own box, so only the moved end changes
+    foreach (const int& connection_id, port->connection_ids)
+    {
+        const connection_dict_t* connection = CanvasGetConnection(connection_id);
+
+        if (!connection)
+            continue;
+
+        from_box->removeLineFromGroup(connection_id);
+        to_box->addLineFromGroup(connection->widget, connection_id);
+    }
+}
+
+// Takes down the lines of every connection of a group, returns the connections for CanvasAttachLines()
+static QList<int> CanvasDetachGroupLines(const group_dict_t* group)
+{
+    QList<int> connection_ids;
+    QSet<int> connection_set;
+
+    for (int i=0; i < 2; i++)
+    {
+        CanvasBox* box = group->widgets[i];
+
+        if (!box)
+            continue;
+
+        foreach (const int& port_id, box->getPortList())
+        {
+            if (const port_dict_t* port = CanvasGetPort(port_id))
+            {
+                foreach (const int& connection_id, port->connection_ids)
+                {
+                    if (!connection_set.contains(connection_id))
+                    {
+                        connection_set.insert(connection_id);
+                        connection_ids.append(connection_id);
+                    }
+                }
+            }
+        }
+    }
+
+    foreach (const int& connection_id, connection_ids)
+    {
+        if (const connection_dict_t* connection = CanvasGetConnection(connection_id))
+            CanvasDetachLine(connection, CanvasGetPort(connection->port_out_id), CanvasGetPort(connection->port_in_id), false);
+    }
+
+    return connection_ids;
+}
+
+static void CanvasAttachLines(const QList<int>& connection_ids)
+{
+    foreach (const int& connection_id, connection_ids)
+    {
+        if (connection_dict_t* connection = CanvasGetConnection(connection_id))
+            CanvasAttachLine(connection, CanvasGetPort(connection->port_out_id), CanvasGetPort(connection->port_in_id), false);
+    }
+}
+
+// Saved position of a box, PORT_MODE_NULL is the joined one
+static bool CanvasGetSavedPos(const QString& group_name, PortMode port_mode, QPointF* pos)
+{
+    return features.handle_group_pos && canvas.layout_store->getPos(group_name, port_mode, pos);
+}
+
+static void CanvasSaveGroupPos(const group_dict_t* group)
+{
+    if (features.handle_group_pos == false)
+        return;
+
+    const QString& group_name = group->group_name;
+
+    if (group->split)
+    {
+        canvas.layout_store->setPos(group_name, PORT_MODE_OUTPUT, group->widgets[0]->pos());
+        canvas.layout_store->setPos(group_name, PORT_MODE_INPUT, group->widgets[1]->pos());
+        canvas.layout_store->setSplit(group_name, SPLIT_YES);
+    }
+    else
+    {
+        canvas.layout_store->setPos(group_name, PORT_MODE_NULL, group->widgets[0]->pos());
+        canvas.layout_store->setSplit(group_name, SPLIT_NO);
+    }
+
+    // Changes made close together go to disk in one write
+    if (!canvas.layout_timer)
+    {
+        canvas.layout_timer = new QTimer(canvas.qobject);
+        canvas.layout_timer->setSingleShot(true);
+        canvas.layout_timer->setInterval(1000);
+        QObject::connect(canvas.layout_timer, SIGNAL(timeout()), canvas.qobject, SLOT(LayoutSync()));
+    }
+
+    canvas.layout_timer->start();
+}
+
+// Removes a connection from the registries and deletes its line right away, no fade
+static void CanvasDropConnection(int connection_id)
+{
+    const connection_dict_t* connection = CanvasGetConnection(connection_id);
+
+    if (!connection)
+        return;
+
+    port_dict_t* port_out = CanvasGetPort(connection->port_out_id);
+    port_dict_t* port_in  = CanvasGetPort(connection->port_in_id);
+
+    CanvasDetachLine(connection, port_out, port_in, false);
+
+    if (port_out)
+        port_out->connection_ids.removeOne(connection_id);
+    if (port_in)
+        port_in->connection_ids.removeOne(connection_id);
+
+    CanvasListTake(canvas.connection_list, canvas.connection_index, connection_id);
+}
+
+// Drops every port of a box (and their connections) from the registries, the port items die with the box
+static void CanvasDropBoxPorts(CanvasBox* box)
+{
+    foreach (const int& port_id, box->getPortList())
+    {
+        const port_dict_t* port = CanvasGetPort(port_id);
+
+        if (!port)
+            continue;
+
+        foreach (const int& connection_id, port->connection_ids)
+            CanvasDropConnection(connection_id);
+
+        canvas.search_index->removePort(port_id);
+        canvas.highlighted_ports.remove(port_id);
+
+        CanvasListTake(canvas.port_list, canvas.port_index, port_id);
+    }
+}
+
 /* PatchCanvas API */
 void setOptions(options_t* new_options)
 {
@@ -179,6 +441,8 @@ void setOptions(options_t* new_options)
     options.use_bezier_lines  = new_options->use_bezier_lines;
     options.antialiasing      = new_options->antialiasing;
     options.eyecandy          = new_options->eyecandy;
+    options.use_line_layer    = new_options->use_line_layer;
+    options.use_item_cache    = new_options->use_item_cache;
 }
 
 void setFeatures(features_t* new_features)
@@ -218,8 +482,22 @@ void init(PatchScene* scene, Callback callback, bool debug)
     canvas.size_rect = QRectF();
 
     if (!canvas.qobject) canvas.qobject = new CanvasObject();
+
+    // Producers run on other threads and never read canvas.qobject, they only see it through here
+    canvas.command_target.fetchAndStoreRelease(canvas.qobject);
+
+    // Commands queued before there was a qobject to wake were left pending, pick them up now.
+    // Posted unconditionally, checking the queue here could race with the first producer.
+    QMetaObject::invokeMethod(canvas.qobject, "CommandsPending", Qt::QueuedConnection);
     if (!canvas.settings) canvas.settings = new QSettings(PATCHCANVAS_ORGANISATION_NAME, "PatchCanvas");
 
+    // Group positions live next to the settings file, which is only read to import old positions
+    if (!canvas.layout_store)
+    {
+        canvas.layout_store = new CanvasLayoutStore();
+        canvas.layout_store->open(QFileInfo(canvas.settings->fileName()).absolutePath()+"/PatchCanvas.layout", canvas.settings);
+    }
+
     if (canvas.theme)
     {
         delete canvas.theme;
@@ -249,27 +527,77 @@ void clear()
     if (canvas.debug)
         qDebug("PatchCanvas::clear()");
 
-    QList<int> group_list_ids;
-    QList<int> port_list_ids;
-    QList<int> connection_list_ids;
+    // Stop all fades, items that were fading out get destroyed right away
+    QVector<animation_dict_t> animations = canvas.animation_list;
 
-    foreach (const group_dict_t& group, canvas.group_list)
-        group_list_ids.append(group.group_id);
+    canvas.animation_list.clear();
+    canvas.animation_index.clear();
 
-    foreach (const port_dict_t& port, canvas.port_list)
-        port_list_ids.append(port.port_id);
+    if (canvas.animation_timer)
+        canvas.animation_timer->stop();
+
+    foreach (const animation_dict_t& animation, animations)
+    {
+        if (animation.destroy)
+            CanvasRemoveItemFX(animation.item);
+    }
+
+    // Lines are top-level scene items, ports go away together with their parent box.
+    // Summary lines are shared by several connections, so each line is deleted once.
+    QSet<AbstractCanvasLine*> lines;
 
     foreach (const connection_dict_t& connection, canvas.connection_list)
-        connection_list_ids.append(connection.connection_id);
+        lines.insert(connection.widget);
+
+    foreach (AbstractCanvasLine* line, lines)
+        line->deleteFromScene();
+
+    foreach (const group_dict_t& group, canvas.group_list)
+    {
+        CanvasSaveGroupPos(&group);
+
+        for (int i=0; i < 2; i++)
+        {
+            if (CanvasBox* box = group.widgets[i])
+            {
+                box->removeIconFromScene();
+                canvas.scene->removeItem(box);
+                delete box;
+            }
+        }
+    }
+
+    // Write the positions saved above right away instead of waiting for the timer
+    if (canvas.layout_timer)
+        canvas.layout_timer->stop();
+
+    if (canvas.layout_store)
+        canvas.layout_store->sync();
+
+    // Queued commands refer to the old graph as well
+    if (canvas.command_timer)
+        canvas.command_timer->stop();
+
+    if (CanvasCommandQueue* queue = canvas.command_queue)
+        queue->discard();
 
-    foreach (const int& idx, connection_list_ids)
-        disconnectPorts(idx);
+    // Drop any layout still being computed, its result refers to the old groups
+    if (canvas.arrange_watcher)
+    {
+        delete canvas.arrange_watcher;
+        canvas.arrange_watcher = 0;
+        canvas.arrange_queued = false;
+    }
 
-    foreach (const int& idx, port_list_ids)
-        removePort(idx);
+    if (canvas.line_layer)
+    {
+        canvas.scene->removeItem(canvas.line_layer);
+        delete canvas.line_layer;
+        canvas.line_layer = 0;
+    }
 
-    foreach (const int& idx, group_list_ids)
-        removeGroup(idx);
+    canvas.dirty_boxes.clear();
+    canvas.dirty_lines.clear();
 
     canvas.last_z_value = 0;
     canvas.last_connection_id = 0;
@@ -277,10 +605,62 @@ void clear()
     canvas.group_list.clear();
     canvas.port_list.clear();
     canvas.connection_list.clear();
+    canvas.group_index.clear();
+    canvas.port_index.clear();
+    canvas.connection_index.clear();
+    canvas.summary_lines.clear();
+    canvas.search_index->clear();
+    canvas.highlighted_ports.clear();
 
     canvas.initiated = false;
 }
 
+void beginUpdate()
+{
+    if (canvas.debug)
+        qDebug("PatchCanvas::beginUpdate()");
+
+    if (canvas.update_depth == 0 && canvas.scene)
+        canvas.scene->beginInteraction();
+
+    canvas.update_depth += 1;
+}
+
+void endUpdate()
+{
+    if (canvas.debug)
+        qDebug("PatchCanvas::endUpdate()");
+
+    if (canvas.update_depth == 0)
+    {
+        qCritical("PatchCanvas::endUpdate() - no update in progress");
+        return;
+    }
+
+    if (canvas.update_depth > 1)
+    {
+        canvas.update_depth -= 1;
+        return;
+    }
+
+    // Lay out each touched box once, their lines are still collected in dirty_lines
+    CanvasFlushBoxUpdates();
+
+    canvas.update_depth = 0;
+
+    QSet<AbstractCanvasLine*> lines = canvas.dirty_lines;
+    canvas.dirty_lines.clear();
+
+    foreach (AbstractCanvasLine* line, lines)
+        line->updateLinePos();
+
+    if (canvas.scene_dirty)
+        CanvasQueueSceneUpdate();
+
+    if (canvas.scene)
+        canvas.scene->endInteraction();
+}
+
 void setInitialPos(int x, int y)
 {
     if (canvas.debug)
@@ -306,17 +686,16 @@ void addGroup(int group_id, QString group_name, SplitOption split, Icon icon)
     if (canvas.debug)
         qDebug("PatchCanvas::addGroup(%i, %s, %s, %s)", group_id, group_name.toUtf8().constData(), split2str(split), icon2str(icon));
 
-    foreach (const group_dict_t& group, canvas.group_list)
+    if (canvas.group_index.contains(group_id))
     {
-        if (group.group_id == group_id)
-        {
-            qWarning("PatchCanvas::addGroup(%i, %s, %s, %s) - group already exists", group_id, group_name.toUtf8().constData(), split2str(split), icon2str(icon));
-            return;
-        }
+        qWarning("PatchCanvas::addGroup(%i, %s, %s, %s) - group already exists", group_id, group_name.toUtf8().constData(), split2str(split), icon2str(icon));
+        return;
     }
 
     if (split == SPLIT_UNDEF && features.handle_group_pos)
-        split = static_cast<SplitOption>(canvas.settings->value(QString("CanvasPositions/%1_SPLIT").arg(group_name), split).toInt());
+        split = canvas.layout_store->getSplit(group_name);
+
+    QPointF saved_pos;
 
     CanvasBox* group_box = new CanvasBox(group_id, group_name, icon);
 
@@ -324,6 +703,7 @@ void addGroup(int group_id, QString group_name, SplitOption split, Icon icon)
     group_dict.group_id   = group_id;
     group_dict.group_name = group_name;
     group_dict.split = (split == SPLIT_YES);
+    group_dict.collapsed = false;
     group_dict.icon  = icon;
     group_dict.widgets[0] = group_box;
     group_dict.widgets[1] = 0;
@@ -332,20 +712,18 @@ void addGroup(int group_id, QString group_name, SplitOption split, Icon icon)
     {
         group_box->setSplit(true, PORT_MODE_OUTPUT);
 
-        if (features.handle_group_pos)
-            group_box->setPos(canvas.settings->value(QString("CanvasPositions/%1_OUTPUT").arg(group_name), CanvasGetNewGroupPos()).toPointF());
-        else
-            group_box->setPos(CanvasGetNewGroupPos());
+        bool has_pos = CanvasGetSavedPos(group_name, PORT_MODE_OUTPUT, &saved_pos);
+        group_box->setPos(has_pos ? saved_pos : CanvasGetNewGroupPos());
+        group_box->setAutoPlaced(!has_pos);
 
         CanvasBox* group_sbox = new CanvasBox(group_id, group_name, icon);
         group_sbox->setSplit(true, PORT_MODE_INPUT);
 
         group_dict.widgets[1] = group_sbox;
 
-        if (features.handle_group_pos)
-            group_sbox->setPos(canvas.settings->value(QString("CanvasPositions/%1_INPUT").arg(group_name), CanvasGetNewGroupPos(true)).toPointF());
-        else
-            group_sbox->setPos(CanvasGetNewGroupPos(true));
+        bool has_spos = CanvasGetSavedPos(group_name, PORT_MODE_INPUT, &saved_pos);
+        group_sbox->setPos(has_spos ? saved_pos : CanvasGetNewGroupPos(true));
+        group_sbox->setAutoPlaced(!has_spos);
 
         canvas.last_z_value += 1;
         group_sbox->setZValue(canvas.last_z_value);
@@ -357,25 +735,32 @@ void addGroup(int group_id, QString group_name, SplitOption split, Icon icon)
     {
         group_box->setSplit(false);
 
-        if (features.handle_group_pos)
-            group_box->setPos(canvas.settings->value(QString("CanvasPositions/%1").arg(group_name), CanvasGetNewGroupPos()).toPointF());
+        bool has_pos = CanvasGetSavedPos(group_name, PORT_MODE_NULL, &saved_pos);
+
+        if (has_pos)
+            group_box->setPos(saved_pos);
+        else if (features.handle_group_pos)
+            group_box->setPos(CanvasGetNewGroupPos());
         else
         {
             // Special ladish fake-split groups
             bool horizontal = (icon == ICON_HARDWARE || icon == ICON_LADISH_ROOM);
             group_box->setPos(CanvasGetNewGroupPos(horizontal));
         }
+
+        group_box->setAutoPlaced(!has_pos);
     }
 
     canvas.last_z_value += 1;
     group_box->setZValue(canvas.last_z_value);
 
-    canvas.group_list.append(group_dict);
+    CanvasListAppend(canvas.group_list, canvas.group_index, group_dict);
+    canvas.search_index->setGroupName(group_id, group_name);
 
     if (options.auto_hide_groups == false && options.eyecandy == EYECANDY_FULL)
         CanvasItemFX(group_box, true);
 
-    QTimer::singleShot(0, canvas.scene, SLOT(update()));
+    CanvasQueueSceneUpdate();
 }
 
 void removeGroup(int group_id)
@@ -383,61 +768,55 @@ void removeGroup(int group_id)
     if (canvas.debug)
         qDebug("PatchCanvas::removeGroup(%i)", group_id);
 
-    foreach2 (const group_dict_t& group, canvas.group_list)
-        if (group.group_id == group_id)
-        {
-            CanvasBox* item = group.widgets[0];
-            QString group_name = group.group_name;
+    group_dict_t* group = CanvasGetGroup(group_id);
 
-            if (group.split)
-            {
-                CanvasBox* s_item = group.widgets[1];
-                if (features.handle_group_pos)
-                {
-                    canvas.settings->setValue(QString("CanvasPositions/%1_OUTPUT").arg(group_name), item->pos());
-                    canvas.settings->setValue(QString("CanvasPositions/%1_INPUT").arg(group_name), s_item->pos());
-                    canvas.settings->setValue(QString("CanvasPositions/%1_SPLIT").arg(group_name), SPLIT_YES);
-                }
+    if (!group)
+    {
+        qCritical("PatchCanvas::removeGroup(%i) - unable to find group to remove", group_id);
+        return;
+    }
 
-                if (options.eyecandy == EYECANDY_FULL)
-                {
-                    CanvasItemFX(s_item, false, true);
-                }
-                else
-                {
-                    s_item->removeIconFromScene();
-                    canvas.scene->removeItem(s_item);
-                    delete s_item;
-                }
-            }
-            else
-            {
-                if (features.handle_group_pos)
-                {
-                    canvas.settings->setValue(QString("CanvasPositions/%1").arg(group_name), item->pos());
-                    canvas.settings->setValue(QString("CanvasPositions/%1_SPLIT").arg(group_name), SPLIT_NO);
-                }
-            }
+    CanvasBox* item = group->widgets[0];
 
-            if (options.eyecandy == EYECANDY_FULL)
-            {
-                CanvasItemFX(item, false, true);
-            }
-            else
-            {
-                item->removeIconFromScene();
-                canvas.scene->removeItem(item);
-                delete item;
-            }
+    // Ports and connections still attached to this group go away together with it
+    CanvasDropBoxPorts(item);
 
-            canvas.group_list.takeAt(i);
+    if (group->split && group->widgets[1])
+        CanvasDropBoxPorts(group->widgets[1]);
 
-            QTimer::singleShot(0, canvas.scene, SLOT(update()));
-            return;
+    CanvasSaveGroupPos(group);
+
+    if (group->split)
+    {
+        CanvasBox* s_item = group->widgets[1];
+
+        if (options.eyecandy == EYECANDY_FULL)
+        {
+            CanvasItemFX(s_item, false, true);
+        }
+        else
+        {
+            s_item->removeIconFromScene();
+            canvas.scene->removeItem(s_item);
+            delete s_item;
         }
     }
 
-    qCritical("PatchCanvas::removeGroup(%i) - unable to find group to remove", group_id);
+    if (options.eyecandy == EYECANDY_FULL)
+    {
+        CanvasItemFX(item, false, true);
+    }
+    else
+    {
+        item->removeIconFromScene();
+        canvas.scene->removeItem(item);
+        delete item;
+    }
+
+    CanvasListTake(canvas.group_list, canvas.group_index, group_id);
+    canvas.search_index->removeGroup(group_id);
+
+    CanvasQueueSceneUpdate();
 }
 
 void renameGroup(int group_id, QString new_group_name)
@@ -445,21 +824,23 @@ void renameGroup(int group_id, QString new_group_name)
     if (canvas.debug)
         qDebug("PatchCanvas::renameGroup(%i, %s)", group_id, new_group_name.toUtf8().constData());
 
-    foreach2 (group_dict_t& group, canvas.group_list)
-        if (group.group_id == group_id)
-        {
-            group.group_name = new_group_name;
-            group.widgets[0]->setGroupName(new_group_name);
-
-            if (group.split && group.widgets[1])
-                group.widgets[1]->setGroupName(new_group_name);
+    group_dict_t* group = CanvasGetGroup(group_id);
 
-            QTimer::singleShot(0, canvas.scene, SLOT(update()));
-            return;
-        }
+    if (!group)
+    {
+        qCritical("PatchCanvas::renameGroup(%i, %s) - unable to find group to rename", group_id, new_group_name.toUtf8().constData());
+        return;
     }
 
-    qCritical("PatchCanvas::renameGroup(%i, %s) - unable to find group to rename", group_id, new_group_name.toUtf8().constData());
+    group->group_name = new_group_name;
+    group->widgets[0]->setGroupName(new_group_name);
+
+    if (group->split && group->widgets[1])
+        group->widgets[1]->setGroupName(new_group_name);
+
+    canvas.search_index->setGroupName(group_id, new_group_name);
+
+    CanvasQueueSceneUpdate();
 }
 
 void splitGroup(int group_id)
@@ -467,180 +848,144 @@ void splitGroup(int group_id)
     if (canvas.debug)
         qDebug("PatchCanvas::splitGroup(%i)", group_id);
 
-    CanvasBox* item = 0;
-    QString group_name;
-    Icon group_icon = ICON_APPLICATION;
-    QList<port_dict_t> ports_data;
-    QList<connection_dict_t> conns_data;
+    group_dict_t* group = CanvasGetGroup(group_id);
 
-    // Step 1 - Store all Item data
-    foreach (const group_dict_t& group, canvas.group_list)
+    if (!group)
     {
-        if (group.group_id == group_id)
-        {
-            if (group.split)
-            {
-                qCritical("PatchCanvas::splitGroup(%i) - group is already splitted", group_id);
-                return;
-            }
-
-            item = group.widgets[0];
-            group_name = group.group_name;
-            group_icon = group.icon;
-            break;
-        }
+        qCritical("PatchCanvas::splitGroup(%i) - unable to find group to split", group_id);
+        return;
     }
 
-    if (!item)
+    if (group->split)
     {
-        qCritical("PatchCanvas::splitGroup(%i) - unable to find group to split", group_id);
+        qCritical("PatchCanvas::splitGroup(%i) - group is already splitted", group_id);
         return;
     }
 
-    QList<int> port_list_ids = QList<int>(item->getPortList());
+    CanvasBox* item = group->widgets[0];
+    QString group_name = group->group_name;
 
-    foreach (const port_dict_t& port, canvas.port_list)
-    {
-        if (port_list_ids.contains(port.port_id))
-        {
-            port_dict_t port_dict;
-            port_dict.group_id  = port.group_id;
-            port_dict.port_id   = port.port_id;
-            port_dict.port_name = port.port_name;
-            port_dict.port_mode = port.port_mode;
-            port_dict.port_type = port.port_type;
-            port_dict.widget    = 0;
-            ports_data.append(port_dict);
-        }
-    }
+    CanvasSaveGroupPos(group);
 
-    foreach (const connection_dict_t& connection, canvas.connection_list)
-    {
-        if (port_list_ids.contains(connection.port_out_id) || port_list_ids.contains(connection.port_in_id))
-        {
-            connection_dict_t connection_dict;
-            connection_dict.connection_id = connection.connection_id;
-            connection_dict.port_in_id    = connection.port_in_id;
-            connection_dict.port_out_id   = connection.port_out_id;
-            connection_dict.widget        = 0;
-            conns_data.append(connection_dict);
-        }
-    }
+    beginUpdate();
 
-    // Step 2 - Remove Item and Children
-    foreach (const connection_dict_t& conn, conns_data)
-        disconnectPorts(conn.connection_id);
+    // Lines of collapsed groups end at summary ports, rebuild them once the ports moved
+    QList<int> connection_ids;
 
-    foreach (const int& port_id, port_list_ids)
-        removePort(port_id);
+    if (group->collapsed)
+        connection_ids = CanvasDetachGroupLines(group);
 
-    removeGroup(group_id);
+    // Step 1 - Create the input box, the current one keeps the outputs
+    item->setSplit(true, PORT_MODE_OUTPUT);
 
-    // Step 3 - Re-create Item, now splitted
-    addGroup(group_id, group_name, SPLIT_YES, group_icon);
+    QPointF saved_pos;
 
-    foreach (const port_dict_t& port, ports_data)
-        addPort(group_id, port.port_id, port.port_name, port.port_mode, port.port_type);
+    if (CanvasGetSavedPos(group_name, PORT_MODE_OUTPUT, &saved_pos))
+        item->setPos(saved_pos);
 
-    foreach (const connection_dict_t& conn, conns_data)
-        connectPorts(conn.connection_id, conn.port_out_id, conn.port_in_id);
+    CanvasBox* s_item = new CanvasBox(group_id, group_name, group->icon);
+    s_item->setSplit(true, PORT_MODE_INPUT);
+    s_item->setCollapsed(group->collapsed);
 
-    QTimer::singleShot(0, canvas.scene, SLOT(update()));
-}
+    bool has_spos = CanvasGetSavedPos(group_name, PORT_MODE_INPUT, &saved_pos);
+    s_item->setPos(has_spos ? saved_pos : CanvasGetNewGroupPos(true));
+    s_item->setAutoPlaced(!has_spos);
 
-void joinGroup(int group_id)
-{
-    if (canvas.debug)
-        qDebug("PatchCanvas::joinGroup(%i)", group_id);
+    canvas.last_z_value += 1;
+    s_item->setZValue(canvas.last_z_value);
 
-    CanvasBox* item = 0;
-    CanvasBox* s_item = 0;
-    QString group_name;
-    Icon group_icon = ICON_APPLICATION;
-    QList<port_dict_t> ports_data;
-    QList<connection_dict_t> conns_data;
+    group->split = true;
+    group->widgets[1] = s_item;
 
-    // Step 1 - Store all Item data
-    foreach (const group_dict_t& group, canvas.group_list)
+    // Step 2 - Move the input ports over, their items and lines are kept
+    foreach (const int& port_id, item->getPortList())
     {
-        if (group.group_id == group_id)
-        {
-            if (group.split == false)
-            {
-                qCritical("PatchCanvas::joinGroup(%i) - group is not splitted", group_id);
-                return;
-            }
+        const port_dict_t* port = CanvasGetPort(port_id);
 
-            item   = group.widgets[0];
-            s_item = group.widgets[1];
-            group_name = group.group_name;
-            group_icon = group.icon;
-            break;
-        }
+        if (port && port->port_mode == PORT_MODE_INPUT)
+            CanvasMovePort(port, item, s_item);
     }
 
-    if (!item || !s_item)
+    CanvasAttachLines(connection_ids);
+
+    if (options.auto_hide_groups == false && options.eyecandy == EYECANDY_FULL)
+        CanvasItemFX(s_item, true);
+
+    CanvasQueueSceneUpdate();
+    endUpdate();
+}
+
+void joinGroup(int group_id)
+{
+    if (canvas.debug)
+        qDebug("PatchCanvas::joinGroup(%i)", group_id);
+
+    group_dict_t* group = CanvasGetGroup(group_id);
+
+    if (!group)
     {
         qCritical("PatchCanvas::joinGroup(%i) - Unable to find groups to join", group_id);
         return;
     }
 
-    QList<int> port_list_ids  = QList<int>(item->getPortList());
-    QList<int> port_list_idss = s_item->getPortList();
-
-    foreach (const int& port_id, port_list_idss)
+    if (group->split == false)
     {
-        if (port_list_ids.contains(port_id) == false)
-            port_list_ids.append(port_id);
+        qCritical("PatchCanvas::joinGroup(%i) - group is not splitted", group_id);
+        return;
     }
 
-    foreach (const port_dict_t& port, canvas.port_list)
+    CanvasBox* item   = group->widgets[0];
+    CanvasBox* s_item = group->widgets[1];
+
+    if (!item || !s_item)
     {
-        if (port_list_ids.contains(port.port_id))
-        {
-            port_dict_t port_dict;
-            port_dict.group_id  = port.group_id;
-            port_dict.port_id   = port.port_id;
-            port_dict.port_name = port.port_name;
-            port_dict.port_mode = port.port_mode;
-            port_dict.port_type = port.port_type;
-            port_dict.widget    = 0;
-            ports_data.append(port_dict);
-        }
+        qCritical("PatchCanvas::joinGroup(%i) - Unable to find groups to join", group_id);
+        return;
     }
 
-    foreach (const connection_dict_t& connection, canvas.connection_list)
+    CanvasSaveGroupPos(group);
+
+    beginUpdate();
+
+    // Lines of collapsed groups end at summary ports, rebuild them once the ports moved
+    QList<int> connection_ids;
+
+    if (group->collapsed)
+        connection_ids = CanvasDetachGroupLines(group);
+
+    // Step 1 - Move the input ports back into the main box
+    foreach (const int& port_id, s_item->getPortList())
     {
-        if (port_list_ids.contains(connection.port_out_id) || port_list_ids.contains(connection.port_in_id))
-        {
-            connection_dict_t connection_dict;
-            connection_dict.connection_id = connection.connection_id;
-            connection_dict.port_in_id    = connection.port_in_id;
-            connection_dict.port_out_id   = connection.port_out_id;
-            connection_dict.widget        = 0;
-            conns_data.append(connection_dict);
-        }
+        if (const port_dict_t* port = CanvasGetPort(port_id))
+            CanvasMovePort(port, s_item, item);
     }
 
-    // Step 2 - Remove Item and Children
-    foreach (const connection_dict_t& conn, conns_data)
-        disconnectPorts(conn.connection_id);
+    item->setSplit(false);
 
-    foreach (const int& port_id, port_list_ids)
-        removePort(port_id);
+    QPointF saved_pos;
 
-    removeGroup(group_id);
+    if (CanvasGetSavedPos(group->group_name, PORT_MODE_NULL, &saved_pos))
+        item->setPos(saved_pos);
 
-    // Step 3 - Re-create Item, now together
-    addGroup(group_id, group_name, SPLIT_NO, group_icon);
+    group->split = false;
+    group->widgets[1] = 0;
 
-    foreach (const port_dict_t& port, ports_data)
-        addPort(group_id, port.port_id, port.port_name, port.port_mode, port.port_type);
+    CanvasAttachLines(connection_ids);
 
-    foreach (const connection_dict_t& conn, conns_data)
-        connectPorts(conn.connection_id, conn.port_out_id, conn.port_in_id);
+    // Step 2 - Remove the now empty input box
+    if (options.eyecandy == EYECANDY_FULL)
+    {
+        CanvasItemFX(s_item, false, true);
+    }
+    else
+    {
+        s_item->removeIconFromScene();
+        canvas.scene->removeItem(s_item);
+        delete s_item;
+    }
 
-    QTimer::singleShot(0, canvas.scene, SLOT(update()));
+    CanvasQueueSceneUpdate();
+    endUpdate();
 }
 
 QPointF getGroupPos(int group_id, PortMode port_mode)
@@ -648,22 +993,19 @@ QPointF getGroupPos(int group_id, PortMode port_mode)
     if (canvas.debug)
         qDebug("PatchCanvas::getGroupPos(%i, %s)", group_id, port_mode2str(port_mode));
 
-    foreach (const group_dict_t& group, canvas.group_list)
+    if (const group_dict_t* group = CanvasGetGroup(group_id))
     {
-        if (group.group_id == group_id)
+        if (group->split)
         {
-            if (group.split)
-            {
-                if (port_mode == PORT_MODE_OUTPUT)
-                    return group.widgets[0]->pos();
-                else if (port_mode == PORT_MODE_INPUT)
-                    return group.widgets[1]->pos();
-                else
-                    return QPointF(0, 0);
-            }
+            if (port_mode == PORT_MODE_OUTPUT)
+                return group->widgets[0]->pos();
+            else if (port_mode == PORT_MODE_INPUT)
+                return group->widgets[1]->pos();
             else
-                return group.widgets[0]->pos();
+                return QPointF(0, 0);
         }
+        else
+            return group->widgets[0]->pos();
     }
 
     qCritical("PatchCanvas::getGroupPos(%i, %s) - unable to find group", group_id, port_mode2str(port_mode));
@@ -680,23 +1022,24 @@ void setGroupPos(int group_id, int group_pos_x, int group_pos_y, int group_pos_x
     if (canvas.debug)
         qDebug("PatchCanvas::setGroupPos(%i, %i, %i, %i, %i)", group_id, group_pos_x, group_pos_y, group_pos_xs, group_pos_ys);
 
-    foreach (const group_dict_t& group, canvas.group_list)
+    const group_dict_t* group = CanvasGetGroup(group_id);
+
+    if (!group)
     {
-        if (group.group_id == group_id)
-        {
-            group.widgets[0]->setPos(group_pos_x, group_pos_y);
+        qCritical("PatchCanvas::setGroupPos(%i, %i, %i, %i, %i) - unable to find group to reposition", group_id, group_pos_x, group_pos_y, group_pos_xs, group_pos_ys);
+        return;
+    }
 
-            if (group.split && group.widgets[1])
-            {
-                group.widgets[1]->setPos(group_pos_xs, group_pos_ys);
-            }
+    group->widgets[0]->setPos(group_pos_x, group_pos_y);
+    group->widgets[0]->setAutoPlaced(false);
 
-            QTimer::singleShot(0, canvas.scene, SLOT(update()));
-            return;
-        }
+    if (group->split && group->widgets[1])
+    {
+        group->widgets[1]->setPos(group_pos_xs, group_pos_ys);
+        group->widgets[1]->setAutoPlaced(false);
     }
 
-    qCritical("PatchCanvas::setGroupPos(%i, %i, %i, %i, %i) - unable to find group to reposition", group_id, group_pos_x, group_pos_y, group_pos_xs, group_pos_ys);
+    CanvasQueueSceneUpdate();
 }
 
 void setGroupIcon(int group_id, Icon icon)
@@ -704,21 +1047,65 @@ void setGroupIcon(int group_id, Icon icon)
     if (canvas.debug)
         qDebug("PatchCanvas::setGroupIcon(%i, %s)", group_id, icon2str(icon));
 
-    foreach2 (group_dict_t& group, canvas.group_list)
-        if (group.group_id == group_id)
-        {
-            group.icon = icon;
-            group.widgets[0]->setIcon(icon);
+    group_dict_t* group = CanvasGetGroup(group_id);
 
-            if (group.split && group.widgets[1])
-                group.widgets[1]->setIcon(icon);
+    if (!group)
+    {
+        qCritical("PatchCanvas::setGroupIcon(%i, %s) - unable to find group to change icon", group_id, icon2str(icon));
+        return;
+    }
 
-            QTimer::singleShot(0, canvas.scene, SLOT(update()));
-            return;
-        }
+    group->icon = icon;
+    group->widgets[0]->setIcon(icon);
+
+    if (group->split && group->widgets[1])
+        group->widgets[1]->setIcon(icon);
+
+    CanvasQueueSceneUpdate();
+}
+
+void setGroupCollapsed(int group_id, bool collapsed)
+{
+    if (canvas.debug)
+        qDebug("PatchCanvas::setGroupCollapsed(%i, %s)", group_id, bool2str(collapsed));
+
+    group_dict_t* group = CanvasGetGroup(group_id);
+
+    if (!group)
+    {
+        qCritical("PatchCanvas::setGroupCollapsed(%i, %s) - unable to find group to collapse", group_id, bool2str(collapsed));
+        return;
+    }
+
+    if (group->collapsed == collapsed)
+        return;
+
+    beginUpdate();
+
+    // Every connection of the group gets its line rebuilt against the new port items
+    QList<int> connection_ids = CanvasDetachGroupLines(group);
+
+    group->collapsed = collapsed;
+
+    for (int i=0; i < 2; i++)
+    {
+        if (CanvasBox* box = group->widgets[i])
+            box->setCollapsed(collapsed);
     }
 
-    qCritical("PatchCanvas::setGroupIcon(%i, %s) - unable to find group to change icon", group_id, icon2str(icon));
+    CanvasAttachLines(connection_ids);
+
+    CanvasQueueSceneUpdate();
+    endUpdate();
+}
+
+bool isGroupCollapsed(int group_id)
+{
+    if (const group_dict_t* group = CanvasGetGroup(group_id))
+        return group->collapsed;
+
+    qCritical("PatchCanvas::isGroupCollapsed(%i) - unable to find group", group_id);
+    return false;
 }
 
 void addPort(int group_id, int port_id, QString port_name, PortMode port_mode, PortType port_type)
@@ -726,40 +1113,66 @@ void addPort(int group_id, int port_id, QString port_name, PortMode port_mode, P
     if (canvas.debug)
         qDebug("PatchCanvas::addPort(%i, %i, %s, %s, %s)", group_id, port_id, port_name.toUtf8().constData(), port_mode2str(port_mode), port_type2str(port_type));
 
-    foreach (const port_dict_t& port, canvas.port_list)
+    if (canvas.port_index.contains(port_id))
+    {
+        qWarning("PatchCanvas::addPort(%i, %i, %s, %s, %s) - port already exists" , group_id, port_id, port_name.toUtf8().constData(), port_mode2str(port_mode), port_type2str(port_type));
+        return;
+    }
+
+    if (CanvasAddPortInternal(group_id, port_id, port_name, port_mode, port_type))
+        CanvasQueueSceneUpdate();
+}
+
+void addPorts(const QList<port_info_t>& ports)
+{
+    if (canvas.debug)
+        qDebug("PatchCanvas::addPorts(%i)", ports.count());
+
+    canvas.port_list.reserve(canvas.port_list.count() + ports.count());
+    canvas.port_index.reserve(canvas.port_index.count() + ports.count());
+
+    beginUpdate();
+
+    // The index is updated as ports get added, so it also catches duplicates within the batch
+    foreach (const port_info_t& port, ports)
     {
-        if (port.group_id == group_id and port.port_id == port_id)
+        if (canvas.port_index.contains(port.port_id))
         {
-            qWarning("PatchCanvas::addPort(%i, %i, %s, %s, %s) - port already exists" , group_id, port_id, port_name.toUtf8().constData(), port_mode2str(port_mode), port_type2str(port_type));
-            return;
+            qWarning("PatchCanvas::addPorts() - port %i already exists", port.port_id);
+            continue;
         }
+
+        CanvasAddPortInternal(port.group_id, port.port_id, port.port_name, port.port_mode, port.port_type);
     }
 
+    CanvasQueueSceneUpdate();
+    endUpdate();
+}
+
+static bool CanvasAddPortInternal(int group_id, int port_id, const QString& port_name, PortMode port_mode, PortType port_type)
+{
     CanvasBox* box_widget = 0;
     CanvasPort* port_widget = 0;
 
-    foreach (const group_dict_t& group, canvas.group_list)
+    if (const group_dict_t* group = CanvasGetGroup(group_id))
     {
-        if (group.group_id == group_id)
-        {
-            int n;
-            if (group.split && group.widgets[0]->getSplittedMode() != port_mode && group.widgets[1])
-                n = 1;
-            else
-                n = 0;
-            box_widget = group.widgets[n];
-            port_widget = box_widget->addPortFromGroup(port_id, port_name, port_mode, port_type);
-            break;
-        }
+        int n;
+        if (group->split && group->widgets[0]->getSplittedMode() != port_mode && group->widgets[1])
+            n = 1;
+        else
+            n = 0;
+        box_widget = group->widgets[n];
+        port_widget = box_widget->addPortFromGroup(port_id, port_name, port_mode, port_type);
     }
 
-    if (!box_widget || !port_widget)
+    // Collapsed boxes do not create port items
+    if (!box_widget || (!port_widget && !box_widget->isCollapsed()))
     {
         qCritical("PatchCanvas::addPort(%i, %i, %s, %s, %s) - unable to find parent group", group_id, port_id, port_name.toUtf8().constData(), port_mode2str(port_mode), port_type2str(port_type));
-        return;
+        return false;
     }
 
-    if (options.eyecandy == EYECANDY_FULL)
+    if (port_widget && options.eyecandy == EYECANDY_FULL)
         CanvasItemFX(port_widget, true);
 
     port_dict_t port_dict;
@@ -769,11 +1182,12 @@ void addPort(int group_id, int port_id, QString port_name, PortMode port_mode, P
     port_dict.port_mode = port_mode;
     port_dict.port_type = port_type;
     port_dict.widget    = port_widget;
-    canvas.port_list.append(port_dict);
+    CanvasListAppend(canvas.port_list, canvas.port_index, port_dict);
+    canvas.search_index->addPort(port_id, group_id, port_name);
 
-    box_widget->updatePositions();
+    CanvasQueueBoxUpdate(box_widget);
 
-    QTimer::singleShot(0, canvas.scene, SLOT(update()));
+    return true;
 }
 
 void removePort(int port_id)
@@ -781,22 +1195,30 @@ void removePort(int port_id)
     if (canvas.debug)
         qDebug("PatchCanvas::removePort(%i)", port_id);
 
-    foreach2 (const port_dict_t& port, canvas.port_list)
-        if (port.port_id == port_id)
-        {
-            CanvasPort* item = port.widget;
-            ((CanvasBox*)item->parentItem())->removePortFromGroup(port_id);
-            canvas.scene->removeItem(item);
-            delete item;
+    const port_dict_t* port = CanvasGetPort(port_id);
+
+    if (!port)
+    {
+        qCritical("PatchCanvas::removePort(%i) - unable to find port to remove", port_id);
+        return;
+    }
 
-            canvas.port_list.takeAt(i);
+    CanvasPort* item = port->widget;
 
-            QTimer::singleShot(0, canvas.scene, SLOT(update()));
-            return;
-        }
+    // The box still needs the port dict to update its summary ports
+    ((CanvasBox*)CanvasGetPortItem(port)->parentItem())->removePortFromGroup(port_id);
+    CanvasListTake(canvas.port_list, canvas.port_index, port_id);
+
+    canvas.search_index->removePort(port_id);
+    canvas.highlighted_ports.remove(port_id);
+
+    if (item)
+    {
+        canvas.scene->removeItem(item);
+        delete item;
     }
 
-    qCritical("PatchCanvas::removePort(%i) - unable to find port to remove", port_id);
+    CanvasQueueSceneUpdate();
 }
 
 void renamePort(int port_id, QString new_port_name)
@@ -804,19 +1226,24 @@ void renamePort(int port_id, QString new_port_name)
     if (canvas.debug)
         qDebug("PatchCanvas::renamePort(%i, %s)", port_id, new_port_name.toUtf8().constData());
 
-    foreach2 (port_dict_t& port, canvas.port_list)
-        if (port.port_id == port_id)
-        {
-            port.port_name = new_port_name;
-            port.widget->setPortName(new_port_name);
-            ((CanvasBox*)port.widget->parentItem())->updatePositions();
+    port_dict_t* port = CanvasGetPort(port_id);
 
-            QTimer::singleShot(0, canvas.scene, SLOT(update()));
-            return;
-        }
+    if (!port)
+    {
+        qCritical("PatchCanvas::renamePort(%i, %s) - unable to find port to rename", port_id, new_port_name.toUtf8().constData());
+        return;
+    }
+
+    port->port_name = new_port_name;
+    canvas.search_index->renamePort(port_id, new_port_name);
+
+    if (port->widget)
+    {
+        port->widget->setPortName(new_port_name);
+        CanvasQueueBoxUpdate((CanvasBox*)port->widget->parentItem());
     }
 
-    qCritical("PatchCanvas::renamePort(%i, %s) - unable to find port to rename", port_id, new_port_name.toUtf8().constData());
+    CanvasQueueSceneUpdate();
 }
 
 void connectPorts(int connection_id, int port_out_id, int port_in_id)
@@ -824,60 +1251,168 @@ void connectPorts(int connection_id, int port_out_id, int port_in_id)
     if (canvas.debug)
         qDebug("PatchCanvas::connectPorts(%i, %i, %i)", connection_id, port_out_id, port_in_id);
 
-    CanvasPort* port_out = 0;
-    CanvasPort* port_in  = 0;
-    CanvasBox* port_out_parent = 0;
-    CanvasBox* port_in_parent  = 0;
+    if (canvas.connection_index.contains(connection_id))
+    {
+        qWarning("PatchCanvas::connectPorts(%i, %i, %i) - connection already exists", connection_id, port_out_id, port_in_id);
+        return;
+    }
+
+    port_dict_t* port_out_dict = CanvasGetPort(port_out_id);
+    port_dict_t* port_in_dict  = CanvasGetPort(port_in_id);
 
-    foreach (const port_dict_t& port, canvas.port_list)
+    if (!port_out_dict || !port_in_dict || port_out_id == port_in_id)
+    {
+        qCritical("PatchCanvas::connectPorts(%i, %i, %i) - Unable to find ports to connect", connection_id, port_out_id, port_in_id);
+        return;
+    }
+
+    CanvasConnectPortsInternal(connection_id, port_out_dict, port_in_dict);
+
+    CanvasQueueSceneUpdate();
+}
+
+void connectPortsBulk(const QList<connection_info_t>& connections)
+{
+    if (canvas.debug)
+        qDebug("PatchCanvas::connectPortsBulk(%i)", connections.count());
+
+    canvas.connection_list.reserve(canvas.connection_list.count() + connections.count());
+    canvas.connection_index.reserve(canvas.connection_index.count() + connections.count());
+
+    beginUpdate();
+
+    foreach (const connection_info_t& connection, connections)
     {
-        if (port.port_id == port_out_id)
+        if (canvas.connection_index.contains(connection.connection_id))
         {
-            port_out = port.widget;
-            port_out_parent = (CanvasBox*)port_out->parentItem();
+            qWarning("PatchCanvas::connectPortsBulk() - connection %i already exists", connection.connection_id);
+            continue;
         }
-        else if (port.port_id == port_in_id)
+
+        port_dict_t* port_out_dict = CanvasGetPort(connection.port_out_id);
+        port_dict_t* port_in_dict  = CanvasGetPort(connection.port_in_id);
+
+        if (!port_out_dict || !port_in_dict || connection.port_out_id == connection.port_in_id)
         {
-            port_in = port.widget;
-            port_in_parent = (CanvasBox*)port_in->parentItem();
+            qCritical("PatchCanvas::connectPortsBulk() - Unable to find ports to connect for connection %i", connection.connection_id);
+            continue;
         }
-    }
 
-    if (!port_out || !port_in)
-    {
-        qCritical("PatchCanvas::connectPorts(%i, %i, %i) - Unable to find ports to connect", connection_id, port_out_id, port_in_id);
-        return;
+        CanvasConnectPortsInternal(connection.connection_id, port_out_dict, port_in_dict);
     }
 
+    CanvasQueueSceneUpdate();
+    endUpdate();
+}
+
+static void CanvasConnectPortsInternal(int connection_id, port_dict_t* port_out_dict, port_dict_t* port_in_dict)
+{
     connection_dict_t connection_dict;
     connection_dict.connection_id = connection_id;
-    connection_dict.port_out_id = port_out_id;
-    connection_dict.port_in_id  = port_in_id;
+    connection_dict.port_out_id = port_out_dict->port_id;
+    connection_dict.port_in_id  = port_in_dict->port_id;
+
+    CanvasAttachLine(&connection_dict, port_out_dict, port_in_dict, true);
+
+    CanvasListAppend(canvas.connection_list, canvas.connection_index, connection_dict);
 
-    if (options.use_bezier_lines)
-        connection_dict.widget = new CanvasBezierLine(port_out, port_in, 0);
+    port_out_dict->connection_ids.append(connection_id);
+    port_in_dict->connection_ids.append(connection_id);
+}
+
+// Shows a connection as a line between the port items of both ends.
+// Connections between the same summary ports of collapsed boxes share one line.
+static void CanvasAttachLine(connection_dict_t* connection, const port_dict_t* port_out_dict, const port_dict_t* port_in_dict, bool fade)
+{
+    CanvasPort* port_out = CanvasGetPortItem(port_out_dict);
+    CanvasPort* port_in  = CanvasGetPortItem(port_in_dict);
+    CanvasBox* port_out_parent = (CanvasBox*)port_out->parentItem();
+    CanvasBox* port_in_parent  = (CanvasBox*)port_in->parentItem();
+
+    bool summary = (port_out->getPortId() < 0 || port_in->getPortId() < 0);
+    QHash<QPair<CanvasPort*, CanvasPort*>, summary_line_t>::iterator it = summary ? canvas.summary_lines.find(qMakePair(port_out, port_in)) : canvas.summary_lines.end();
+
+    if (it != canvas.summary_lines.end())
+    {
+        it.value().refcount += 1;
+        connection->widget = it.value().line;
+    }
     else
-        connection_dict.widget = new CanvasLine(port_out, port_in, 0);
+    {
+        if (options.use_line_layer)
+        {
+            if (!canvas.line_layer)
+            {
+                canvas.line_layer = new CanvasLineLayer(0);
+                canvas.line_layer->updateZValue();
+            }
+            connection->widget = new CanvasLayerLine(port_out, port_in, canvas.line_layer);
+        }
+        else if (options.use_bezier_lines)
+            connection->widget = new CanvasBezierLine(port_out, port_in, 0);
+        else
+            connection->widget = new CanvasLine(port_out, port_in, 0);
 
-    port_out_parent->addLineFromGroup(connection_dict.widget, connection_id);
-    port_in_parent->addLineFromGroup(connection_dict.widget, connection_id);
+        canvas.last_z_value += 1;
+        port_out_parent->setZValue(canvas.last_z_value);
+        port_in_parent->setZValue(canvas.last_z_value);
 
-    canvas.last_z_value += 1;
-    port_out_parent->setZValue(canvas.last_z_value);
-    port_in_parent->setZValue(canvas.last_z_value);
+        canvas.last_z_value += 1;
+        connection->widget->setZValue(canvas.last_z_value);
 
-    canvas.last_z_value += 1;
-    connection_dict.widget->setZValue(canvas.last_z_value);
+        if (summary)
+        {
+            summary_line_t summary_line;
+            summary_line.line = connection->widget;
+            summary_line.refcount = 1;
+            canvas.summary_lines.insert(qMakePair(port_out, port_in), summary_line);
+        }
 
-    canvas.connection_list.append(connection_dict);
+        // Layer lines are not scene items of their own, they cannot fade
+        if (fade && options.eyecandy == EYECANDY_FULL && !options.use_line_layer)
+        {
+            QGraphicsItem* item = (options.use_bezier_lines) ? (QGraphicsItem*)(CanvasBezierLine*)connection->widget : (QGraphicsItem*)(CanvasLine*)connection->widget;
+            CanvasItemFX(item, true);
+        }
+    }
 
-    if (options.eyecandy == EYECANDY_FULL)
+    port_out_parent->addLineFromGroup(connection->widget, connection->connection_id);
+    port_in_parent->addLineFromGroup(connection->widget, connection->connection_id);
+}
+
+// Undoes CanvasAttachLine, a shared line stays until its last connection goes away
+static void CanvasDetachLine(const connection_dict_t* connection, const port_dict_t* port_out_dict, const port_dict_t* port_in_dict, bool fade)
+{
+    AbstractCanvasLine* line = connection->widget;
+    CanvasPort* port_out = port_out_dict ? CanvasGetPortItem(port_out_dict) : 0;
+    CanvasPort* port_in  = port_in_dict  ? CanvasGetPortItem(port_in_dict)  : 0;
+
+    if (port_out)
+        ((CanvasBox*)port_out->parentItem())->removeLineFromGroup(connection->connection_id);
+    if (port_in)
+        ((CanvasBox*)port_in->parentItem())->removeLineFromGroup(connection->connection_id);
+
+    QHash<QPair<CanvasPort*, CanvasPort*>, summary_line_t>::iterator it = canvas.summary_lines.find(qMakePair(port_out, port_in));
+
+    if (it != canvas.summary_lines.end() && it.value().line == line)
     {
-        QGraphicsItem* item = (options.use_bezier_lines) ? (QGraphicsItem*)(CanvasBezierLine*)connection_dict.widget : (QGraphicsItem*)(CanvasLine*)connection_dict.widget;
-        CanvasItemFX(item, true);
+        it.value().refcount -= 1;
+
+        if (it.value().refcount > 0)
+            return;
+
+        canvas.summary_lines.erase(it);
     }
 
-    QTimer::singleShot(0, canvas.scene, SLOT(update()));
+    canvas.dirty_lines.remove(line);
+
+    if (fade && options.eyecandy == EYECANDY_FULL && !options.use_line_layer)
+    {
+        QGraphicsItem* item = (options.use_bezier_lines) ? (QGraphicsItem*)(CanvasBezierLine*)line : (QGraphicsItem*)(CanvasLine*)line;
+        CanvasItemFX(item, false, true);
+    }
+    else
+        line->deleteFromScene();
 }
 
 void disconnectPorts(int connection_id)
@@ -885,178 +1420,731 @@ void disconnectPorts(int connection_id)
     if (canvas.debug)
         qDebug("PatchCanvas::disconnectPorts(%i)", connection_id);
 
-    int port_1_id, port_2_id;
-    AbstractCanvasLine* line = 0;
-    QGraphicsItem* item1 = 0;
-    QGraphicsItem* item2 = 0;
-
-    foreach2 (const connection_dict_t& connection, canvas.connection_list)
-        if (connection.connection_id == connection_id)
-        {
-            port_1_id = connection.port_out_id;
-            port_2_id = connection.port_in_id;
-            line = connection.widget;
-            canvas.connection_list.takeAt(i);
-            break;
-        }
-    }
+    const connection_dict_t* connection = CanvasGetConnection(connection_id);
 
-    if (!line)
+    if (!connection)
     {
         qCritical("PatchCanvas::disconnectPorts(%i) - unable to find connection ports", connection_id);
         return;
     }
 
-    foreach (const port_dict_t& port, canvas.port_list)
-    {
-        if (port.port_id == port_1_id)
-        {
-            item1 = port.widget;
-            break;
-        }
-    }
+    port_dict_t* port_out = CanvasGetPort(connection->port_out_id);
 
-    if (!item1)
+    if (!port_out)
     {
         qCritical("PatchCanvas::disconnectPorts(%i) - unable to find output port", connection_id);
         return;
     }
 
-    foreach (const port_dict_t& port, canvas.port_list)
-    {
-        if (port.port_id == port_2_id)
-        {
-            item2 = port.widget;
-            break;
-        }
-    }
+    port_dict_t* port_in = CanvasGetPort(connection->port_in_id);
 
-    if (!item2)
+    if (!port_in)
     {
         qCritical("PatchCanvas::disconnectPorts(%i) - unable to find input port", connection_id);
         return;
     }
 
-    ((CanvasBox*)item1->parentItem())->removeLineFromGroup(connection_id);
-    ((CanvasBox*)item2->parentItem())->removeLineFromGroup(connection_id);
+    CanvasDetachLine(connection, port_out, port_in, true);
 
-    if (options.eyecandy == EYECANDY_FULL)
-    {
-        QGraphicsItem* item = (options.use_bezier_lines) ? (QGraphicsItem*)(CanvasBezierLine*)line : (QGraphicsItem*)(CanvasLine*)line;
-        CanvasItemFX(item, false, true);
-    }
-    else
-        line->deleteFromScene();
+    port_out->connection_ids.removeOne(connection_id);
+    port_in->connection_ids.removeOne(connection_id);
 
-    QTimer::singleShot(0, canvas.scene, SLOT(update()));
-}
+    CanvasListTake(canvas.connection_list, canvas.connection_index, connection_id);
 
-void arrange()
-{
-    if (canvas.debug)
-        qDebug("PatchCanvas::Arrange()");
+    CanvasQueueSceneUpdate();
 }
 
-void updateZValues()
+void applyGraph(const QList<group_info_t>& groups, const QList<port_info_t>& ports, const QList<connection_info_t>& connections)
 {
     if (canvas.debug)
-        qDebug("PatchCanvas::updateZValues()");
+        qDebug("PatchCanvas::applyGraph(%i, %i, %i)", groups.count(), ports.count(), connections.count());
 
+    QHash<int, const group_info_t*> new_groups;
+    QHash<int, const port_info_t*> new_ports;
+    QHash<int, const connection_info_t*> new_connections;
 
-    foreach (const group_dict_t& group, canvas.group_list)
-    {
-        group.widgets[0]->resetLinesZValue();
+    new_groups.reserve(groups.count());
+    new_ports.reserve(ports.count());
+    new_connections.reserve(connections.count());
 
-        if (group.split and group.widgets[1])
-            group.widgets[1]->resetLinesZValue();
-    }
-}
+    for (int i=0; i < groups.count(); i++)
+        new_groups.insert(groups.at(i).group_id, &groups.at(i));
 
-/* Extra Internal functions */
+    for (int i=0; i < ports.count(); i++)
+        new_ports.insert(ports.at(i).port_id, &ports.at(i));
 
-QString CanvasGetGroupName(int group_id)
-{
-    if (canvas.debug)
-        qDebug("PatchCanvas::CanvasGetGroupName(%i)", group_id);
+    for (int i=0; i < connections.count(); i++)
+        new_connections.insert(connections.at(i).connection_id, &connections.at(i));
+
+    // Step 1 - Find what is gone or changed identity, ports of removed groups go away with them
+    QList<int> old_group_ids;
+    QSet<int> old_port_ids;
+    QList<int> old_connection_ids;
 
     foreach (const group_dict_t& group, canvas.group_list)
     {
-        if (group.group_id == group_id)
-            return group.group_name;
+        if (!new_groups.contains(group.group_id))
+            old_group_ids.append(group.group_id);
     }
 
-    qCritical("PatchCanvas::CanvasGetGroupName(%i) - unable to find group", group_id);
-    return "";
-}
-
-int CanvasGetGroupPortCount(int group_id)
-{
-    if (canvas.debug)
-        qDebug("PatchCanvas::CanvasGetGroupPortCount(%i)", group_id);
-
-    int port_count = 0;
     foreach (const port_dict_t& port, canvas.port_list)
     {
-        if (port.group_id == group_id)
-            port_count += 1;
+        const port_info_t* new_port = new_ports.value(port.port_id, 0);
+
+        if (!new_port || new_port->group_id != port.group_id || new_port->port_mode != port.port_mode || new_port->port_type != port.port_type)
+            old_port_ids.insert(port.port_id);
     }
 
-    return port_count;
-}
+    foreach (const connection_dict_t& connection, canvas.connection_list)
+    {
+        const connection_info_t* new_connection = new_connections.value(connection.connection_id, 0);
 
-QPointF CanvasGetNewGroupPos(bool horizontal)
+        if (!new_connection || new_connection->port_out_id != connection.port_out_id || new_connection->port_in_id != connection.port_in_id ||
+            old_port_ids.contains(connection.port_out_id) || old_port_ids.contains(connection.port_in_id))
+            old_connection_ids.append(connection.connection_id);
+    }
+
+    beginUpdate();
+
+    // Step 2 - Remove connections, then ports, then groups
+    foreach (const int& connection_id, old_connection_ids)
+        disconnectPorts(connection_id);
+
+    foreach (const int& port_id, old_port_ids)
+    {
+        const port_dict_t* port = CanvasGetPort(port_id);
+
+        if (port && new_groups.contains(port->group_id))
+            removePort(port_id);
+    }
+
+    foreach (const int& group_id, old_group_ids)
+        removeGroup(group_id);
+
+    // Step 3 - Add or update groups
+    foreach (const group_info_t& group, groups)
+    {
+        group_dict_t* group_dict = CanvasGetGroup(group.group_id);
+
+        if (!group_dict)
+        {
+            addGroup(group.group_id, group.group_name, group.split, group.icon);
+            continue;
+        }
+
+        if (group_dict->group_name != group.group_name)
+            renameGroup(group.group_id, group.group_name);
+
+        if (group_dict->icon != group.icon)
+            setGroupIcon(group.group_id, group.icon);
+
+        if (group.split == SPLIT_YES && !group_dict->split)
+            splitGroup(group.group_id);
+        else if (group.split == SPLIT_NO && group_dict->split)
+            joinGroup(group.group_id);
+    }
+
+    // Step 4 - Add or rename ports
+    QList<port_info_t> add_ports;
+
+    foreach (const port_info_t& port, ports)
+    {
+        const port_dict_t* port_dict = CanvasGetPort(port.port_id);
+
+        if (!port_dict)
+            add_ports.append(port);
+        else if (port_dict->port_name != port.port_name)
+            renamePort(port.port_id, port.port_name);
+    }
+
+    if (add_ports.count() > 0)
+        addPorts(add_ports);
+
+    // Step 5 - Add connections
+    QList<connection_info_t> add_connections;
+
+    foreach (const connection_info_t& connection, connections)
+    {
+        if (!canvas.connection_index.contains(connection.connection_id))
+            add_connections.append(connection);
+    }
+
+    if (add_connections.count() > 0)
+        connectPortsBulk(add_connections);
+
+    CanvasQueueSceneUpdate();
+    endUpdate();
+}
+
+QList<int> searchPorts(const QString& text)
 {
     if (canvas.debug)
-        qDebug("PatchCanvas::CanvasGetNewGroupPos(%s)", bool2str(horizontal));
+        qDebug("PatchCanvas::searchPorts(%s)", text.toUtf8().constData());
 
-    QPointF new_pos(canvas.initial_pos.x(), canvas.initial_pos.y());
-    QList<QGraphicsItem*> items = canvas.scene->items();
+    return canvas.search_index->search(text);
+}
 
-    bool break_loop = false;
-    while (break_loop == false)
+void highlightPorts(const QList<int>& port_ids, bool focus)
+{
+    if (canvas.debug)
+        qDebug("PatchCanvas::highlightPorts(%i, %s)", port_ids.count(), bool2str(focus));
+
+    // Summary ports stand in for several ports, so everything goes off before the new set goes on
+    foreach (const int& port_id, canvas.highlighted_ports)
     {
-        bool break_for = false;
-        for (int i=0; i < items.count(); i++)
+        if (const port_dict_t* port = CanvasGetPort(port_id))
+        {
+            if (CanvasPort* item = CanvasGetPortItem(port))
+                item->setHighlighted(false);
+        }
+    }
+
+    canvas.highlighted_ports.clear();
+
+    QRectF rect;
+
+    foreach (const int& port_id, port_ids)
+    {
+        const port_dict_t* port = CanvasGetPort(port_id);
+        CanvasPort* item = port ? CanvasGetPortItem(port) : 0;
+
+        if (!item)
+        {
+            qWarning("PatchCanvas::highlightPorts() - unable to find port %i", port_id);
+            continue;
+        }
+
+        item->setHighlighted(true);
+        canvas.highlighted_ports.insert(port_id);
+
+        if (item->isVisible())
+            rect |= item->sceneBoundingRect();
+    }
+
+    if (focus && !rect.isNull())
+        canvas.scene->focusRect(rect);
+}
+
+// The ring is large, so it only gets allocated once something actually queues a command.
+// Producers may race to create it, the loser deletes its copy.
+static CanvasCommandQueue* CanvasGetCommandQueue()
+{
+    CanvasCommandQueue* queue = canvas.command_queue;
+
+    if (!queue)
+    {
+        queue = new CanvasCommandQueue();
+
+        if (!canvas.command_queue.testAndSetOrdered(0, queue))
         {
-            QGraphicsItem* item = items[i];
-            if (item && item->type() == CanvasBoxType)
+            delete queue;
+            queue = canvas.command_queue;
+        }
+    }
+
+    return queue;
+}
+
+static bool CanvasPushCommand(const canvas_command_t& command)
+{
+    CanvasCommandQueue* queue = CanvasGetCommandQueue();
+
+    if (!queue->push(command))
+        return false;
+
+    // Only the first command of a frame posts an event to the GUI thread
+    if (queue->markPending())
+    {
+        // Before init() there is nothing to wake, init() posts for those commands itself
+        if (CanvasObject* target = canvas.command_target)
+            QMetaObject::invokeMethod(target, "CommandsPending", Qt::QueuedConnection);
+    }
+
+    return true;
+}
+
+bool queueAddGroup(int group_id, const char* group_name, SplitOption split, Icon icon)
+{
+    canvas_command_t command = canvas_command_t();
+    command.type = COMMAND_ADD_GROUP;
+    command.group_id = group_id;
+    command.split = split;
+    command.icon  = icon;
+    CanvasCommandSetName(&command, group_name);
+    return CanvasPushCommand(command);
+}
+
+bool queueRemoveGroup(int group_id)
+{
+    canvas_command_t command = canvas_command_t();
+    command.type = COMMAND_REMOVE_GROUP;
+    command.group_id = group_id;
+    return CanvasPushCommand(command);
+}
+
+bool queueRenameGroup(int group_id, const char* new_group_name)
+{
+    canvas_command_t command = canvas_command_t();
+    command.type = COMMAND_RENAME_GROUP;
+    command.group_id = group_id;
+    CanvasCommandSetName(&command, new_group_name);
+    return CanvasPushCommand(command);
+}
+
+bool queueAddPort(int group_id, int port_id, const char* port_name, PortMode port_mode, PortType port_type)
+{
+    canvas_command_t command = canvas_command_t();
+    command.type = COMMAND_ADD_PORT;
+    command.group_id  = group_id;
+    command.port_id   = port_id;
+    command.port_mode = port_mode;
+    command.port_type = port_type;
+    CanvasCommandSetName(&command, port_name);
+    return CanvasPushCommand(command);
+}
+
+bool queueRemovePort(int port_id)
+{
+    canvas_command_t command = canvas_command_t();
+    command.type = COMMAND_REMOVE_PORT;
+    command.port_id = port_id;
+    return CanvasPushCommand(command);
+}
+
+bool queueRenamePort(int port_id, const char* new_port_name)
+{
+    canvas_command_t command = canvas_command_t();
+    command.type = COMMAND_RENAME_PORT;
+    command.port_id = port_id;
+    CanvasCommandSetName(&command, new_port_name);
+    return CanvasPushCommand(command);
+}
+
+bool queueConnectPorts(int connection_id, int port_out_id, int port_in_id)
+{
+    canvas_command_t command = canvas_command_t();
+    command.type = COMMAND_CONNECT_PORTS;
+    command.connection_id = connection_id;
+    command.port_out_id = port_out_id;
+    command.port_in_id  = port_in_id;
+    return CanvasPushCommand(command);
+}
+
+bool queueDisconnectPorts(int connection_id)
+{
+    canvas_command_t command = canvas_command_t();
+    command.type = COMMAND_DISCONNECT_PORTS;
+    command.connection_id = connection_id;
+    return CanvasPushCommand(command);
+}
+
+void arrange(bool incremental)
+{
+    if (canvas.debug)
+        qDebug("PatchCanvas::arrange(%s)", bool2str(incremental));
+
+    if (!canvas.arrange_watcher)
+    {
+        canvas.arrange_watcher = new QFutureWatcher<arrange_data_t>(canvas.qobject);
+        QObject::connect(canvas.arrange_watcher, SIGNAL(finished()), canvas.qobject, SLOT(ArrangeFinished()));
+    }
+
+    // Run again once the current pass is done, a full pass wins over an incremental one
+    if (canvas.arrange_watcher->isRunning())
+    {
+        canvas.arrange_queued_incremental = canvas.arrange_queued ? (canvas.arrange_queued_incremental && incremental) : incremental;
+        canvas.arrange_queued = true;
+        return;
+    }
+
+    // Box sizes must be final before taking the snapshot
+    CanvasFlushBoxUpdates();
+
+    arrange_data_t data;
+    data.origin = canvas.initial_pos;
+    data.nodes.reserve(canvas.group_list.count()*2);
+    data.edges.reserve(canvas.connection_list.count());
+
+    QHash<const CanvasBox*, int> node_index;
+    bool has_new = false;
+
+    // Node order seeds the layer order, group ids keep it independent of earlier removals
+    QList<int> group_ids = canvas.group_index.keys();
+    qSort(group_ids);
+
+    foreach (const int& group_id, group_ids)
+    {
+        const group_dict_t& group = canvas.group_list.at(canvas.group_index.value(group_id));
+
+        for (int i=0; i < 2; i++)
+        {
+            CanvasBox* box = group.widgets[i];
+
+            if (!box || !box->isVisible())
+                continue;
+
+            arrange_node_t node;
+            node.group_id  = group.group_id;
+            node.box_index = i;
+            node.size  = box->boundingRect().size();
+            node.pos   = box->pos();
+            node.fixed = incremental && !box->isAutoPlaced();
+
+            has_new |= !node.fixed;
+            node_index.insert(box, data.nodes.count());
+            data.nodes.append(node);
+        }
+    }
+
+    if (!has_new)
+        return;
+
+    foreach (const connection_dict_t& connection, canvas.connection_list)
+    {
+        const port_dict_t* port_out = CanvasGetPort(connection.port_out_id);
+        const port_dict_t* port_in  = CanvasGetPort(connection.port_in_id);
+
+        if (!port_out || !port_in)
+            continue;
+
+        arrange_edge_t edge;
+        edge.node_out = node_index.value((CanvasBox*)CanvasGetPortItem(port_out)->parentItem(), -1);
+        edge.node_in  = node_index.value((CanvasBox*)CanvasGetPortItem(port_in)->parentItem(), -1);
+
+        if (edge.node_out >= 0 && edge.node_in >= 0)
+            data.edges.append(edge);
+    }
+
+    canvas.arrange_watcher->setFuture(QtConcurrent::run(CanvasArrangeLayout, data));
+}
+
+void updateZValues()
+{
+    if (canvas.debug)
+        qDebug("PatchCanvas::updateZValues()");
+
+
+    foreach (const group_dict_t& group, canvas.group_list)
+    {
+        group.widgets[0]->resetLinesZValue();
+
+        if (group.split and group.widgets[1])
+            group.widgets[1]->resetLinesZValue();
+    }
+
+    if (canvas.line_layer)
+        canvas.line_layer->updateZValue();
+}
+
+static const quint32 STATE_MAGIC   = 0x50435354; // "PCST"
+static const quint32 STATE_VERSION = 1;
+
+struct state_box_t {
+    QPointF pos;
+    qreal z_value;
+    bool auto_placed;
+};
+
+struct state_group_t {
+    int group_id;
+    QString group_name;
+    bool split;
+    bool collapsed;
+    Icon icon;
+    int box_count;
+    state_box_t boxes[2];
+};
+
+QByteArray saveState()
+{
+    if (canvas.debug)
+        qDebug("PatchCanvas::saveState()");
+
+    QByteArray state;
+    QDataStream stream(&state, QIODevice::WriteOnly);
+    stream.setVersion(QDataStream::Qt_4_6);
+
+    stream << STATE_MAGIC << STATE_VERSION;
+
+    // Ports are written box by box, in the order the boxes show them
+    QList<port_info_t> ports;
+
+    stream << qint32(canvas.group_list.count());
+
+    foreach (const group_dict_t& group, canvas.group_list)
+    {
+        int box_count = (group.split && group.widgets[1]) ? 2 : 1;
+
+        stream << qint32(group.group_id) << group.group_name << group.split << group.collapsed << qint32(group.icon) << qint32(box_count);
+
+        for (int i=0; i < box_count; i++)
+        {
+            CanvasBox* box = group.widgets[i];
+
+            stream << box->pos() << box->zValue() << box->isAutoPlaced();
+
+            foreach (const int& port_id, box->getPortList())
             {
-                if (item->sceneBoundingRect().contains(new_pos))
+                if (const port_dict_t* port = CanvasGetPort(port_id))
                 {
-                    if (horizontal)
-                        new_pos += QPointF(item->boundingRect().width()+15, 0);
-                    else
-                        new_pos += QPointF(0, item->boundingRect().height()+15);
-                    break;
+                    port_info_t port_info;
+                    port_info.group_id  = port->group_id;
+                    port_info.port_id   = port->port_id;
+                    port_info.port_name = port->port_name;
+                    port_info.port_mode = port->port_mode;
+                    port_info.port_type = port->port_type;
+                    ports.append(port_info);
                 }
             }
-            if (i >= items.count()-1 && break_for == false)
-                break_loop = true;
         }
     }
 
-    return new_pos;
+    stream << qint32(ports.count());
+
+    foreach (const port_info_t& port, ports)
+        stream << qint32(port.group_id) << qint32(port.port_id) << port.port_name << qint32(port.port_mode) << qint32(port.port_type);
+
+    stream << qint32(canvas.connection_list.count());
+
+    foreach (const connection_dict_t& connection, canvas.connection_list)
+        stream << qint32(connection.connection_id) << qint32(connection.port_out_id) << qint32(connection.port_in_id);
+
+    stream << quint64(canvas.last_z_value) << qint32(canvas.last_connection_id);
+
+    return state;
 }
 
-QString CanvasGetFullPortName(int port_id)
+bool restoreState(const QByteArray& state)
 {
     if (canvas.debug)
-        qDebug("PatchCanvas::CanvasGetFullPortName(%i)", port_id);
+        qDebug("PatchCanvas::restoreState(%i)", state.size());
 
-    foreach (const port_dict_t& port, canvas.port_list)
+    if (canvas.group_list.count() > 0)
+    {
+        qCritical("PatchCanvas::restoreState() - canvas is not empty");
+        return false;
+    }
+
+    QDataStream stream(state);
+    stream.setVersion(QDataStream::Qt_4_6);
+
+    quint32 magic, version;
+    stream >> magic >> version;
+
+    if (stream.status() != QDataStream::Ok || magic != STATE_MAGIC || version != STATE_VERSION)
     {
-        if (port.port_id == port_id)
+        qCritical("PatchCanvas::restoreState() - invalid state data");
+        return false;
+    }
+
+    // Read everything first, broken data must not leave a half restored canvas behind
+    qint32 count;
+    QList<state_group_t> groups;
+    QList<port_info_t> ports;
+    QList<connection_info_t> connections;
+
+    stream >> count;
+    for (qint32 i=0; i < count && stream.status() == QDataStream::Ok; i++)
+    {
+        state_group_t group;
+        qint32 group_id, icon, box_count;
+
+        stream >> group_id >> group.group_name >> group.split >> group.collapsed >> icon >> box_count;
+
+        group.group_id  = group_id;
+        group.icon      = static_cast<Icon>(icon);
+        group.box_count = qBound(1, int(box_count), 2);
+
+        for (int j=0; j < group.box_count; j++)
+            stream >> group.boxes[j].pos >> group.boxes[j].z_value >> group.boxes[j].auto_placed;
+
+        groups.append(group);
+    }
+
+    stream >> count;
+    for (qint32 i=0; i < count && stream.status() == QDataStream::Ok; i++)
+    {
+        port_info_t port;
+        qint32 group_id, port_id, port_mode, port_type;
+
+        stream >> group_id >> port_id >> port.port_name >> port_mode >> port_type;
+
+        port.group_id  = group_id;
+        port.port_id   = port_id;
+        port.port_mode = static_cast<PortMode>(port_mode);
+        port.port_type = static_cast<PortType>(port_type);
+        ports.append(port);
+    }
+
+    stream >> count;
+    for (qint32 i=0; i < count && stream.status() == QDataStream::Ok; i++)
+    {
+        connection_info_t connection;
+        qint32 connection_id, port_out_id, port_in_id;
+
+        stream >> connection_id >> port_out_id >> port_in_id;
+
+        connection.connection_id = connection_id;
+        connection.port_out_id   = port_out_id;
+        connection.port_in_id    = port_in_id;
+        connections.append(connection);
+    }
+
+    quint64 last_z_value;
+    qint32 last_connection_id;
+    stream >> last_z_value >> last_connection_id;
+
+    if (stream.status() != QDataStream::Ok)
+    {
+        qCritical("PatchCanvas::restoreState() - truncated state data");
+        return false;
+    }
+
+    canvas.suppress_fx = true;
+    beginUpdate();
+
+    // Collapse before adding ports, so collapsed groups never create port items
+    foreach (const state_group_t& group, groups)
+    {
+        addGroup(group.group_id, group.group_name, group.split ? SPLIT_YES : SPLIT_NO, group.icon);
+
+        if (group.collapsed)
+            setGroupCollapsed(group.group_id, true);
+    }
+
+    addPorts(ports);
+    connectPortsBulk(connections);
+
+    // Connecting raises boxes, so positions and z-order are applied last
+    foreach (const state_group_t& group, groups)
+    {
+        const group_dict_t* group_dict = CanvasGetGroup(group.group_id);
+
+        if (!group_dict)
+            continue;
+
+        for (int i=0; i < group.box_count; i++)
         {
-            int group_id = port.group_id;
-            foreach (const group_dict_t& group, canvas.group_list)
+            if (CanvasBox* box = group_dict->widgets[i])
             {
-                if (group.group_id == group_id)
-                    return group.group_name + ":" + port.port_name;
+                box->setPos(group.boxes[i].pos);
+                box->setZValue(group.boxes[i].z_value);
+                box->setAutoPlaced(group.boxes[i].auto_placed);
             }
-            break;
         }
     }
 
+    canvas.last_z_value = qMax(canvas.last_z_value, (unsigned long)last_z_value);
+    canvas.last_connection_id = last_connection_id;
+
+    updateZValues();
+
+    endUpdate();
+    canvas.suppress_fx = false;
+
+    return true;
+}
+
+/* Extra Internal functions */
+
+group_dict_t* CanvasGetGroup(int group_id)
+{
+    QHash<int, int>::const_iterator it = canvas.group_index.constFind(group_id);
+    return (it != canvas.group_index.constEnd()) ? &canvas.group_list[it.value()] : 0;
+}
+
+port_dict_t* CanvasGetPort(int port_id)
+{
+    QHash<int, int>::const_iterator it = canvas.port_index.constFind(port_id);
+    return (it != canvas.port_index.constEnd()) ? &canvas.port_list[it.value()] : 0;
+}
+
+connection_dict_t* CanvasGetConnection(int connection_id)
+{
+    QHash<int, int>::const_iterator it = canvas.connection_index.constFind(connection_id);
+    return (it != canvas.connection_index.constEnd()) ? &canvas.connection_list[it.value()] : 0;
+}
+
+CanvasPort* CanvasGetPortItem(const port_dict_t* port)
+{
+    if (port->widget)
+        return port->widget;
+
+    // Ports of collapsed boxes are shown by the summary port of their mode and type
+    if (const group_dict_t* group = CanvasGetGroup(port->group_id))
+    {
+        CanvasBox* box = group->widgets[0];
+
+        if (group->split && group->widgets[1] && box->getSplittedMode() != port->port_mode)
+            box = group->widgets[1];
+
+        return box->getSummaryPort(port->port_mode, port->port_type);
+    }
+
+    return 0;
+}
+
+QString CanvasGetGroupName(int group_id)
+{
+    if (canvas.debug)
+        qDebug("PatchCanvas::CanvasGetGroupName(%i)", group_id);
+
+    if (const group_dict_t* group = CanvasGetGroup(group_id))
+        return group->group_name;
+
+    qCritical("PatchCanvas::CanvasGetGroupName(%i) - unable to find group", group_id);
+    return "";
+}
+
+int CanvasGetGroupPortCount(int group_id)
+{
+    if (canvas.debug)
+        qDebug("PatchCanvas::CanvasGetGroupPortCount(%i)", group_id);
+
+    int port_count = 0;
+    if (const group_dict_t* group = CanvasGetGroup(group_id))
+    {
+        port_count += group->widgets[0]->getPortCount();
+
+        if (group->split && group->widgets[1])
+            port_count += group->widgets[1]->getPortCount();
+    }
+
+    return port_count;
+}
+
+QPointF CanvasGetNewGroupPos(bool horizontal)
+{
+    if (canvas.debug)
+        qDebug("PatchCanvas::CanvasGetNewGroupPos(%s)", bool2str(horizontal));
+
+    // Boxes added in the current batch need their real size before looking for free space
+    CanvasFlushBoxUpdates();
+
+    QPointF new_pos(canvas.initial_pos.x(), canvas.initial_pos.y());
+
+    while (const CanvasBox* box = canvas.box_grid->boxAt(new_pos))
+    {
+        if (horizontal)
+            new_pos += QPointF(box->boundingRect().width()+15, 0);
+        else
+            new_pos += QPointF(0, box->boundingRect().height()+15);
+    }
+
+    return new_pos;
+}
+
+QString CanvasGetFullPortName(int port_id)
+{
+    if (canvas.debug)
+        qDebug("PatchCanvas::CanvasGetFullPortName(%i)", port_id);
+
+    if (const port_dict_t* port = CanvasGetPort(port_id))
+    {
+        if (const group_dict_t* group = CanvasGetGroup(port->group_id))
+            return group->group_name + ":" + port->port_name;
+    }
+
     qCritical("PatchCanvas::CanvasGetFullPortName(%i) - unable to find port", port_id);
     return "";
 }
@@ -1066,50 +2154,344 @@ QList<int> CanvasGetPortConnectionList(int port_id)
     if (canvas.debug)
         qDebug("PatchCanvas::CanvasGetPortConnectionList(%i)", port_id);
 
-    QList<int> port_con_list;
+    if (const port_dict_t* port = CanvasGetPort(port_id))
+        return port->connection_ids;
 
-    foreach (const connection_dict_t& connection, canvas.connection_list)
+    return QList<int>();
+}
+
+int CanvasGetConnectedPort(int connection_id, int port_id)
+{
+    if (canvas.debug)
+        qDebug("PatchCanvas::CanvasGetConnectedPort(%i, %i)", connection_id, port_id);
+
+    if (const connection_dict_t* connection = CanvasGetConnection(connection_id))
     {
-        if (connection.port_out_id == port_id || connection.port_in_id == port_id)
-            port_con_list.append(connection.connection_id);
+        if (connection->port_out_id == port_id)
+            return connection->port_in_id;
+        else
+            return connection->port_out_id;
     }
 
-    return port_con_list;
+    qCritical("PatchCanvas::CanvasGetConnectedPort(%i, %i) - unable to find connection", connection_id, port_id);
+    return 0;
 }
 
-int CanvasGetConnectedPort(int connection_id, int port_id)
+void CanvasQueueBoxUpdate(CanvasBox* box)
+{
+    if (canvas.update_depth > 0)
+        canvas.dirty_boxes.insert(box);
+    else
+        box->updatePositions();
+}
+
+void CanvasFlushBoxUpdates()
+{
+    // updatePositions() never queues, but keep going in case a box got re-added meanwhile
+    while (canvas.dirty_boxes.isEmpty() == false)
+    {
+        QSet<CanvasBox*> boxes = canvas.dirty_boxes;
+        canvas.dirty_boxes.clear();
+
+        foreach (CanvasBox* box, boxes)
+            box->updatePositions();
+    }
+}
+
+void CanvasQueueSceneUpdate()
+{
+    if (canvas.update_depth > 0)
+    {
+        canvas.scene_dirty = true;
+        return;
+    }
+
+    canvas.scene_dirty = false;
+
+    if (canvas.scene_update_pending || !canvas.qobject)
+        return;
+
+    canvas.scene_update_pending = true;
+    QTimer::singleShot(0, canvas.qobject, SLOT(SceneUpdate()));
+}
+
+// Takes the animation out of the list in O(1), the last entry fills its slot
+static animation_dict_t CanvasTakeAnimation(int index)
+{
+    animation_dict_t animation = canvas.animation_list[index];
+    int last = canvas.animation_list.count()-1;
+
+    if (index != last)
+    {
+        canvas.animation_list[index] = canvas.animation_list[last];
+        canvas.animation_index[canvas.animation_list[index].item] = index;
+    }
+
+    canvas.animation_list.resize(last);
+    canvas.animation_index.remove(animation.item);
+
+    return animation;
+}
+
+// Puts the item in its final state, may delete it
+static void CanvasFinishAnimation(const animation_dict_t& animation)
+{
+    if (animation.show)
+        animation.item->setOpacity(1.0);
+    else if (animation.destroy)
+        CanvasRemoveItemFX(animation.item);
+    else
+        animation.item->hide();
+}
+
+void CanvasAnimationTick()
+{
+    qint64 now = canvas.animation_clock.elapsed();
+    QRectF visible_rect = canvas.scene->getVisibleRect();
+
+    // Walk backwards so finished entries can be swapped out while iterating
+    for (int i=canvas.animation_list.count()-1; i >= 0; i--)
+    {
+        if (i >= canvas.animation_list.count())
+            continue;
+
+        const animation_dict_t& animation = canvas.animation_list[i];
+        qint64 elapsed = now-animation.start_time;
+
+        if (elapsed >= animation.duration || !animation.item->sceneBoundingRect().intersects(visible_rect))
+        {
+            CanvasFinishAnimation(CanvasTakeAnimation(i));
+            continue;
+        }
+
+        qreal value = qreal(elapsed)/animation.duration;
+        animation.item->setOpacity(animation.show ? value : 1.0-value);
+    }
+
+    if (canvas.animation_list.isEmpty())
+        canvas.animation_timer->stop();
+}
+
+void CanvasBeginDrag(CanvasBox* box, const QPointF& scene_pos)
+{
+    CanvasEndDrag();
+
+    canvas.drag_origin  = scene_pos;
+    canvas.drag_pos     = scene_pos;
+    canvas.drag_pending = false;
+
+    // Every selected box follows the pointer, like QGraphicsItem's own move handling
+    QList<QGraphicsItem*> items = canvas.scene->selectedItems();
+
+    if (!box->isSelected())
+        items.append(box);
+
+    foreach (QGraphicsItem* item, items)
+    {
+        if (item->type() == CanvasBoxType && (item->flags() & QGraphicsItem::ItemIsMovable))
+        {
+            drag_box_t drag_box;
+            drag_box.box = (CanvasBox*)item;
+            drag_box.start_pos = item->pos();
+            canvas.drag_list.append(drag_box);
+        }
+    }
+
+    if (!canvas.drag_timer)
+    {
+        canvas.drag_timer = new QTimer(canvas.qobject);
+        canvas.drag_timer->setInterval(16);
+        QObject::connect(canvas.drag_timer, SIGNAL(timeout()), canvas.qobject, SLOT(DragTick()));
+    }
+
+    if (canvas.drag_list.isEmpty())
+        return;
+
+    canvas.scene->beginInteraction();
+    canvas.drag_timer->start();
+}
+
+void CanvasUpdateDrag(const QPointF& scene_pos)
+{
+    // Only remember the latest pointer position, the timer applies it once per frame
+    canvas.drag_pos = scene_pos;
+    canvas.drag_pending = true;
+}
+
+void CanvasFlushDrag()
+{
+    if (!canvas.drag_pending)
+        return;
+
+    canvas.drag_pending = false;
+
+    QPointF offset = canvas.drag_pos-canvas.drag_origin;
+
+    // Lines shared by several dragged boxes get updated once
+    beginUpdate();
+
+    foreach (const drag_box_t& drag_box, canvas.drag_list)
+        drag_box.box->setPos(drag_box.start_pos+offset);
+
+    endUpdate();
+}
+
+void CanvasEndDrag()
+{
+    if (canvas.drag_list.isEmpty())
+        return;
+
+    CanvasFlushDrag();
+
+    canvas.drag_list.clear();
+    canvas.drag_timer->stop();
+    canvas.scene->endInteraction();
+}
+
+void CanvasRemoveFromDrag(CanvasBox* box)
+{
+    for (int i=0; i < canvas.drag_list.count(); i++)
+    {
+        if (canvas.drag_list[i].box == box)
+        {
+            canvas.drag_list.removeAt(i);
+            break;
+        }
+    }
+
+    if (canvas.drag_list.isEmpty() && canvas.drag_timer && canvas.drag_timer->isActive())
+    {
+        canvas.drag_timer->stop();
+        canvas.scene->endInteraction();
+    }
+}
+
+void CanvasArrangeFinished()
 {
     if (canvas.debug)
-        qDebug("PatchCanvas::CanvasGetConnectedPort(%i, %i)", connection_id, port_id);
+        qDebug("PatchCanvas::CanvasArrangeFinished()");
 
-    foreach (const connection_dict_t& connection, canvas.connection_list)
+    const arrange_data_t data = canvas.arrange_watcher->result();
+
+    beginUpdate();
+
+    // Groups may have changed while the layout was computed, only touch what still exists
+    foreach (const arrange_node_t& node, data.nodes)
     {
-        if (connection.connection_id == connection_id)
+        if (node.fixed)
+            continue;
+
+        const group_dict_t* group = CanvasGetGroup(node.group_id);
+        if (!group)
+            continue;
+
+        if (CanvasBox* box = group->widgets[node.box_index])
         {
-            if (connection.port_out_id == port_id)
-                return connection.port_in_id;
-            else
-                return connection.port_out_id;
+            box->setPos(node.pos);
+            box->setAutoPlaced(false);
         }
     }
 
-    qCritical("PatchCanvas::CanvasGetConnectedPort(%i, %i) - unable to find connection", connection_id, port_id);
-    return 0;
+    endUpdate();
+
+    CanvasQueueSceneUpdate();
+
+    if (canvas.arrange_queued)
+    {
+        canvas.arrange_queued = false;
+        arrange(canvas.arrange_queued_incremental);
+    }
 }
 
-void CanvasRemoveAnimation(CanvasFadeAnimation* f_animation)
+void CanvasProcessCommands()
 {
+    CanvasCommandQueue* queue = canvas.command_queue;
+
+    if (!queue)
+        return;
+
+    QVector<canvas_command_t> commands;
+    queue->take(&commands);
+
+    if (int dropped = queue->takeDropped())
+        qWarning("PatchCanvas::CanvasProcessCommands() - command queue was full, %i commands were dropped", dropped);
+
+    if (commands.isEmpty())
+        return;
+
     if (canvas.debug)
-        qDebug("PatchCanvas::CanvasRemoveAnimation(%p)", f_animation);
+        qDebug("PatchCanvas::CanvasProcessCommands() - %i commands", commands.count());
+
+    // Runs of port additions and connections go through the bulk calls
+    QList<port_info_t> add_ports;
+    QList<connection_info_t> add_connections;
 
-    foreach2 (const animation_dict_t& animation, canvas.animation_list)
-        if (animation.animation == f_animation)
+    beginUpdate();
+
+    foreach (const canvas_command_t& command, commands)
+    {
+        if (command.type != COMMAND_ADD_PORT && add_ports.count() > 0)
         {
-            delete animation.animation;
-            canvas.animation_list.takeAt(i);
+            addPorts(add_ports);
+            add_ports.clear();
+        }
+
+        if (command.type != COMMAND_CONNECT_PORTS && add_connections.count() > 0)
+        {
+            connectPortsBulk(add_connections);
+            add_connections.clear();
+        }
+
+        switch (command.type)
+        {
+        case COMMAND_ADD_GROUP:
+            addGroup(command.group_id, QString::fromUtf8(command.name), static_cast<SplitOption>(command.split), static_cast<Icon>(command.icon));
+            break;
+        case COMMAND_REMOVE_GROUP:
+            removeGroup(command.group_id);
+            break;
+        case COMMAND_RENAME_GROUP:
+            renameGroup(command.group_id, QString::fromUtf8(command.name));
+            break;
+        case COMMAND_ADD_PORT:
+        {
+            port_info_t port;
+            port.group_id  = command.group_id;
+            port.port_id   = command.port_id;
+            port.port_name = QString::fromUtf8(command.name);
+            port.port_mode = static_cast<PortMode>(command.port_mode);
+            port.port_type = static_cast<PortType>(command.port_type);
+            add_ports.append(port);
+            break;
+        }
+        case COMMAND_REMOVE_PORT:
+            removePort(command.port_id);
+            break;
+        case COMMAND_RENAME_PORT:
+            renamePort(command.port_id, QString::fromUtf8(command.name));
+            break;
+        case COMMAND_CONNECT_PORTS:
+        {
+            connection_info_t connection;
+            connection.connection_id = command.connection_id;
+            connection.port_out_id = command.port_out_id;
+            connection.port_in_id  = command.port_in_id;
+            add_connections.append(connection);
+            break;
+        }
+        case COMMAND_DISCONNECT_PORTS:
+            disconnectPorts(command.connection_id);
             break;
         }
     }
+
+    if (add_ports.count() > 0)
+        addPorts(add_ports);
+
+    if (add_connections.count() > 0)
+        connectPortsBulk(add_connections);
+
+    endUpdate();
 }
 
 void CanvasPostponedGroups()
@@ -1131,41 +2513,56 @@ void CanvasItemFX(QGraphicsItem* item, bool show, bool destroy)
     if (canvas.debug)
         qDebug("PatchCanvas::CanvasItemFX(%p, %s, %s)", item, bool2str(show), bool2str(destroy));
 
-    // Check if item already has an animationItemFX
-    foreach2 (const animation_dict_t& animation, canvas.animation_list)
-        if (animation.item == item)
-        {
-            if (animation.animation)
-            {
-                animation.animation->stop();
-                delete animation.animation;
-            }
-            canvas.animation_list.takeAt(i);
-            break;
-        }
-    }
-
-    CanvasFadeAnimation* animation = new CanvasFadeAnimation(item, show);
-    animation->setDuration(show ? 750 : 500);
+    // A new fade replaces whatever the item was doing
+    CanvasCancelItemFX(item);
 
-    animation_dict_t animation_dict;
-    animation_dict.animation = animation;
-    animation_dict.item = item;
-    canvas.animation_list.append(animation_dict);
+    animation_dict_t animation;
+    animation.item = item;
+    animation.duration = show ? 750 : 500;
+    animation.show = show;
+    animation.destroy = (!show && destroy);
 
-    if (show)
+    // Nothing to fade for hidden items or items nobody can see
+    if (canvas.suppress_fx || (!show && item->opacity() == 0.0) || !item->sceneBoundingRect().intersects(canvas.scene->getVisibleRect()))
     {
-        QObject::connect(animation, SIGNAL(finished()), canvas.qobject, SLOT(AnimationIdle()));
+        if (show)
+            item->show();
+        CanvasFinishAnimation(animation);
+        return;
     }
-    else
+
+    item->show();
+    item->setOpacity(show ? 0.0 : 1.0);
+
+    // A box on its way out no longer counts for zoom_fit()
+    if (item->type() == CanvasBoxType)
+        canvas.box_grid->setBoxShown((CanvasBox*)item, show);
+
+    if (!canvas.animation_timer)
     {
-        if (destroy)
-            QObject::connect(animation, SIGNAL(finished()), canvas.qobject, SLOT(AnimationDestroy()));
-        else
-            QObject::connect(animation, SIGNAL(finished()), canvas.qobject, SLOT(AnimationHide()));
+        canvas.animation_timer = new QTimer(canvas.qobject);
+        canvas.animation_timer->setInterval(16);
+        QObject::connect(canvas.animation_timer, SIGNAL(timeout()), canvas.qobject, SLOT(AnimationTick()));
     }
 
-    animation->start();
+    if (!canvas.animation_clock.isValid())
+        canvas.animation_clock.start();
+
+    animation.start_time = canvas.animation_clock.elapsed();
+
+    canvas.animation_index.insert(item, canvas.animation_list.count());
+    canvas.animation_list.append(animation);
+
+    if (!canvas.animation_timer->isActive())
+        canvas.animation_timer->start();
+}
+
+void CanvasCancelItemFX(QGraphicsItem* item)
+{
+    QHash<QGraphicsItem*, int>::const_iterator it = canvas.animation_index.find(item);
+
+    if (it != canvas.animation_index.end())
+        CanvasTakeAnimation(it.value());
 }
 
 void CanvasRemoveItemFX(QGraphicsItem* item)
@@ -1181,18 +2578,26 @@ void CanvasRemoveItemFX(QGraphicsItem* item)
         box->removeIconFromScene();
         canvas.scene->removeItem(box);
         delete box;
+        break;
     }
     case CanvasPortType:
     {
         CanvasPort* port = (CanvasPort*)item;
         canvas.scene->removeItem(port);
         delete port;
+        break;
     }
     case CanvasLineType:
+    {
+        AbstractCanvasLine* line = (CanvasLine*)item;
+        line->deleteFromScene();
+        break;
+    }
     case CanvasBezierLineType:
     {
-        AbstractCanvasLine* line = (AbstractCanvasLine*)item;
+        AbstractCanvasLine* line = (CanvasBezierLine*)item;
         line->deleteFromScene();
+        break;
     }
     default:
         break;
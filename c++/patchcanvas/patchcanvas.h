@@ -18,6 +18,12 @@
 #ifndef PATCHCANVAS_H
 #define PATCHCANVAS_H
 
+#include <QtCore/QAtomicPointer>
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QHash>
+#include <QtCore/QPair>
+#include <QtCore/QSet>
+#include <QtCore/QVector>
 #include <QtGui/QGraphicsItem>
 
 #include "../patchcanvas.h"
@@ -28,6 +34,8 @@
 class QSettings;
 class QTimer;
 
+template <typename T> class QFutureWatcher;
+
 class CanvasObject : public QObject {
     Q_OBJECT
 
@@ -35,21 +43,31 @@ public:
     CanvasObject(QObject* parent=0);
 
 public slots:
-    void AnimationIdle();
-    void AnimationHide();
-    void AnimationDestroy();
+    void AnimationTick();
+    void DragTick();
     void CanvasPostponedGroups();
     void PortContextMenuDisconnect();
+    void SceneUpdate();
+    void ArrangeFinished();
+    void LayoutSync();
+    void CommandsPending();
+    void CommandTick();
 };
 
 START_NAMESPACE_PATCHCANVAS
 
 class AbstractCanvasLine;
-class CanvasFadeAnimation;
 class CanvasBox;
+class CanvasBoxGrid;
+class CanvasCommandQueue;
+class CanvasLayoutStore;
 class CanvasPort;
+class CanvasLineLayer;
+class CanvasSearchIndex;
 class Theme;
 
+struct arrange_data_t;
+
 // object types
 enum CanvasType {
     CanvasBoxType           = QGraphicsItem::UserType + 1,
@@ -58,7 +76,15 @@ enum CanvasType {
     CanvasLineType          = QGraphicsItem::UserType + 4,
     CanvasBezierLineType    = QGraphicsItem::UserType + 5,
     CanvasLineMovType       = QGraphicsItem::UserType + 6,
-    CanvasBezierLineMovType = QGraphicsItem::UserType + 7
+    CanvasBezierLineMovType = QGraphicsItem::UserType + 7,
+    CanvasLineLayerType     = QGraphicsItem::UserType + 8
+};
+
+// level of detail, picked from the view scale
+enum DetailLevel {
+    DETAIL_FULL   = 0, // everything
+    DETAIL_MEDIUM = 1, // no port names or icons
+    DETAIL_LOW    = 2  // flat boxes and ports, straight lines, no antialiasing
 };
 
 // object lists
@@ -66,6 +92,7 @@ struct group_dict_t {
     int group_id;
     QString group_name;
     bool split;
+    bool collapsed;
     Icon icon;
     CanvasBox* widgets[2];
 };
@@ -76,6 +103,7 @@ struct port_dict_t {
     QString port_name;
     PortMode port_mode;
     PortType port_type;
+    QList<int> connection_ids;
     CanvasPort* widget;
 };
 
@@ -86,9 +114,23 @@ struct connection_dict_t {
     AbstractCanvasLine* widget;
 };
 
+// Line shared by all connections between the same summary ports
+struct summary_line_t {
+    AbstractCanvasLine* line;
+    int refcount;
+};
+
 struct animation_dict_t {
-    CanvasFadeAnimation* animation;
     QGraphicsItem* item;
+    qint64 start_time;
+    int duration;
+    bool show;
+    bool destroy;
+};
+
+struct drag_box_t {
+    CanvasBox* box;
+    QPointF start_pos;
 };
 
 // Main Canvas object
@@ -107,9 +149,40 @@ public:
     QList<group_dict_t> group_list;
     QList<port_dict_t> port_list;
     QList<connection_dict_t> connection_list;
-    QList<animation_dict_t> animation_list;
+    QHash<int, int> group_index;      // group_id -> position in group_list
+    QHash<int, int> port_index;       // port_id -> position in port_list
+    QHash<int, int> connection_index; // connection_id -> position in connection_list
+    QHash<QPair<CanvasPort*, CanvasPort*>, summary_line_t> summary_lines; // (output, input) -> line
+    QVector<animation_dict_t> animation_list;
+    QHash<QGraphicsItem*, int> animation_index; // item -> position in animation_list
+    QTimer* animation_timer;
+    QElapsedTimer animation_clock;
+    QList<drag_box_t> drag_list;
+    QPointF drag_origin;
+    QPointF drag_pos;
+    bool drag_pending;
+    QTimer* drag_timer;
+    bool suppress_fx;
+    int update_depth;
+    QSet<CanvasBox*> dirty_boxes;
+    QSet<AbstractCanvasLine*> dirty_lines;
+    bool scene_dirty;
+    bool scene_update_pending;
+    CanvasLineLayer* line_layer;
+    CanvasBoxGrid* box_grid;
+    CanvasSearchIndex* search_index;
+    QSet<int> highlighted_ports;
+    DetailLevel detail_level;
+    QFutureWatcher<arrange_data_t>* arrange_watcher;
+    bool arrange_queued;
+    bool arrange_queued_incremental;
     CanvasObject* qobject;
     QSettings* settings;
+    CanvasLayoutStore* layout_store;
+    QTimer* layout_timer;
+    QAtomicPointer<CanvasCommandQueue> command_queue; // created by the first queued command
+    QAtomicPointer<CanvasObject> command_target; // qobject once init() made it, what producers wake
+    QTimer* command_timer;
     Theme* theme;
     bool initiated;
 };
@@ -120,17 +193,33 @@ const char* port_type2str(PortType port_type);
 const char* icon2str(Icon icon);
 const char* split2str(SplitOption split);
 
+group_dict_t* CanvasGetGroup(int group_id);
+port_dict_t* CanvasGetPort(int port_id);
+connection_dict_t* CanvasGetConnection(int connection_id);
+CanvasPort* CanvasGetPortItem(const port_dict_t* port);
+
 QString CanvasGetGroupName(int group_id);
 int CanvasGetGroupPortCount(int group_id);
 QPointF CanvasGetNewGroupPos(bool horizontal=false);
 QString CanvasGetFullPortName(int port_id);
 QList<int> CanvasGetPortConnectionList(int port_id);
 int CanvasGetConnectedPort(int connection_id, int port_id);
-void CanvasRemoveAnimation(CanvasFadeAnimation* f_animation);
+void CanvasQueueBoxUpdate(CanvasBox* box);
+void CanvasFlushBoxUpdates();
+void CanvasQueueSceneUpdate();
+void CanvasAnimationTick();
+void CanvasBeginDrag(CanvasBox* box, const QPointF& scene_pos);
+void CanvasUpdateDrag(const QPointF& scene_pos);
+void CanvasFlushDrag();
+void CanvasEndDrag();
+void CanvasRemoveFromDrag(CanvasBox* box);
 void CanvasPostponedGroups();
+void CanvasArrangeFinished();
+void CanvasProcessCommands();
 void CanvasCallback(CallbackAction action, int value1, int value2, QString value_str);
 void CanvasItemFX(QGraphicsItem* item, bool show, bool destroy=false);
 void CanvasRemoveItemFX(QGraphicsItem* item);
+void CanvasCancelItemFX(QGraphicsItem* item);
 
 // global objects
 extern Canvas canvas;
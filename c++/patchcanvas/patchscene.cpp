@@ -18,6 +18,7 @@
 #include "patchscene.h"
 
 #include <cmath>
+#include <QtCore/QTimer>
 #include <QtGui/QKeyEvent>
 #include <QtGui/QGraphicsRectItem>
 #include <QtGui/QGraphicsSceneMouseEvent>
@@ -26,6 +27,7 @@
 
 #include "patchcanvas/patchcanvas.h"
 #include "patchcanvas/canvasbox.h"
+#include "patchcanvas/canvasboxgrid.h"
 
 using namespace PatchCanvas;
 
@@ -45,6 +47,12 @@ PatchScene::PatchScene(QObject* parent, QGraphicsView* view) :
     m_view = view;
     if (! m_view)
         qFatal("PatchCanvas::PatchScene() - invalid view");
+
+    m_interaction_depth = 0;
+    m_index_timer = new QTimer(this);
+    m_index_timer->setSingleShot(true);
+    m_index_timer->setInterval(250);
+    connect(m_index_timer, SIGNAL(timeout()), SLOT(restoreIndex()));
 }
 
 void PatchScene::fixScaleFactor()
@@ -60,6 +68,7 @@ void PatchScene::fixScaleFactor()
       m_view->resetTransform();
       m_view->scale(0.2, 0.2);
     }
+    updateDetailLevel();
     emit scaleChanged(m_view->transform().m11());
 }
 
@@ -70,51 +79,74 @@ void PatchScene::updateTheme()
     m_rubberband->setBrush(canvas.theme->rubberband_brush);
 }
 
-void PatchScene::zoom_fit()
+QRectF PatchScene::getVisibleRect() const
+{
+    return m_view->mapToScene(m_view->viewport()->rect()).boundingRect();
+}
+
+void PatchScene::focusRect(const QRectF& rect)
 {
-    qreal min_x, min_y, max_x, max_y;
-    bool first_value = true;
+    QRectF visible_rect = getVisibleRect();
 
-    QList<QGraphicsItem*> items_list = items();
+    if (visible_rect.contains(rect))
+        return;
 
-    if (items_list.count() > 0)
+    if (rect.width() < visible_rect.width() && rect.height() < visible_rect.height())
     {
-        foreach (const QGraphicsItem* item, items_list)
-        {
-            if (item && item->isVisible() and item->type() == CanvasBoxType)
-            {
-                QPointF pos = item->scenePos();
-                QRectF rect = item->boundingRect();
-
-                if (first_value)
-                    min_x = pos.x();
-                else if (pos.x() < min_x)
-                    min_x = pos.x();
-
-                if (first_value)
-                    min_y = pos.y();
-                else if (pos.y() < min_y)
-                    min_y = pos.y();
-
-                if (first_value)
-                    max_x = pos.x()+rect.width();
-                else if (pos.x()+rect.width() > max_x)
-                    max_x = pos.x()+rect.width();
-
-                if (first_value)
-                    max_y = pos.y()+rect.height();
-                else if (pos.y()+rect.height() > max_y)
-                    max_y = pos.y()+rect.height();
-
-                first_value = false;
-            }
-        }
+        m_view->centerOn(rect.center());
+    }
+    else
+    {
+        m_view->fitInView(rect.adjusted(-20, -20, 20, 20), Qt::KeepAspectRatio);
+        fixScaleFactor();
+    }
+}
 
-        if (first_value == false)
-        {
-            m_view->fitInView(min_x, min_y, abs(max_x-min_x), abs(max_y-min_y), Qt::KeepAspectRatio);
-            fixScaleFactor();
-        }
+void PatchScene::beginInteraction()
+{
+    if (m_interaction_depth++ > 0)
+        return;
+
+    m_index_timer->stop();
+
+    if (itemIndexMethod() != QGraphicsScene::NoIndex)
+        setItemIndexMethod(QGraphicsScene::NoIndex);
+}
+
+void PatchScene::endInteraction()
+{
+    if (m_interaction_depth == 0)
+    {
+        qWarning("PatchCanvas::PatchScene::endInteraction() - no interaction in progress");
+        return;
+    }
+
+    // Wait a bit, the next drag or batch usually follows right away
+    if (--m_interaction_depth == 0)
+        m_index_timer->start();
+}
+
+void PatchScene::restoreIndex()
+{
+    if (m_interaction_depth > 0)
+        return;
+
+    // Roughly 4 items per leaf, deeper trees cost more to rebuild than they save on lookups
+    int count = qMax(items().count()/4, 1);
+    int depth = qBound(4, int(std::log(qreal(count))/std::log(2.0)/2.0)+3, 12);
+
+    setBspTreeDepth(depth);
+    setItemIndexMethod(QGraphicsScene::BspTreeIndex);
+}
+
+void PatchScene::zoom_fit()
+{
+    QRectF rect = canvas.box_grid->boundingRect();
+
+    if (!rect.isNull())
+    {
+        m_view->fitInView(rect, Qt::KeepAspectRatio);
+        fixScaleFactor();
     }
 }
 
@@ -122,6 +154,7 @@ void PatchScene::zoom_in()
 {
     if (m_view->transform().m11() < 3.0)
         m_view->scale(1.2, 1.2);
+    updateDetailLevel();
     emit scaleChanged(m_view->transform().m11());
 }
 
@@ -129,15 +162,36 @@ void PatchScene::zoom_out()
 {
     if (m_view->transform().m11() > 0.2)
         m_view->scale(0.8, 0.8);
+    updateDetailLevel();
     emit scaleChanged(m_view->transform().m11());
 }
 
 void PatchScene::zoom_reset()
 {
     m_view->resetTransform();
+    updateDetailLevel();
     emit scaleChanged(1.0);
 }
 
+void PatchScene::updateDetailLevel()
+{
+    qreal scale = m_view->transform().m11();
+    DetailLevel detail_level;
+
+    if (scale < 0.35)
+        detail_level = DETAIL_LOW;
+    else if (scale < 0.6)
+        detail_level = DETAIL_MEDIUM;
+    else
+        detail_level = DETAIL_FULL;
+
+    if (detail_level != canvas.detail_level)
+    {
+        canvas.detail_level = detail_level;
+        update();
+    }
+}
+
 void PatchScene::keyPressEvent(QKeyEvent* event)
 {
     if (! m_view)
@@ -252,6 +306,9 @@ void PatchScene::mouseReleaseEvent(QGraphicsSceneMouseEvent* event)
     }
     else
     {
+        // Apply the last pending drag step before reading box positions
+        CanvasEndDrag();
+
         QList<QGraphicsItem*> items_list = selectedItems();
         foreach (QGraphicsItem* item, items_list)
         {
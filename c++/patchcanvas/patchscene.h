@@ -25,6 +25,7 @@ class QGraphicsRectItem;
 class QGraphicsSceneMouseEvent;
 class QGraphicsSceneWheelEvent;
 class QGraphicsView;
+class QTimer;
 
 class PatchScene : public QGraphicsScene
 {
@@ -36,6 +37,15 @@ public:
     void fixScaleFactor();
     void updateTheme();
 
+    QRectF getVisibleRect() const;
+
+    // Scrolls rect into view, zooming out only when it does not fit
+    void focusRect(const QRectF& rect);
+
+    // Drop the BSP index while many items move, it is rebuilt once things settle
+    void beginInteraction();
+    void endInteraction();
+
     void zoom_fit();
     void zoom_in();
     void zoom_out();
@@ -56,12 +66,20 @@ private:
 
     QGraphicsView* m_view;
 
+    int m_interaction_depth;
+    QTimer* m_index_timer;
+
+    void updateDetailLevel();
+
     virtual void keyPressEvent(QKeyEvent* event);
     virtual void keyReleaseEvent(QKeyEvent* event);
     virtual void mousePressEvent(QGraphicsSceneMouseEvent* event);
     virtual void mouseMoveEvent(QGraphicsSceneMouseEvent* event);
     virtual void mouseReleaseEvent(QGraphicsSceneMouseEvent* event);
     virtual void wheelEvent(QGraphicsSceneWheelEvent* event);
+
+private slots:
+    void restoreIndex();
 };
 
 #endif // PATCHSCENE_H
@@ -0,0 +1,173 @@
+/*
+ * Patchbay Canvas engine using QGraphicsView/Scene
+ * Copyright (C) 2010-2012 Filipe Coelho <falktx@falktx.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * For a full copy of the GNU General Public License see the COPYING file
+ */
+
+
+#include "canvascommandqueue.h"
+
+#include <cstdio>
+#include <cstring>
+
+using namespace PatchCanvas;
+
+static int failures = 0;
+
+#define CHECK(cond) \
+    if (!(cond)) { std::fprintf(stderr, "%s:%i: check failed: %s\n", __FILE__, __LINE__, #cond); failures++; }
+
+static canvas_command_t command(CanvasCommandType type, int id, int arg1=0, int arg2=0, const char* name="")
+{
+    canvas_command_t command;
+    memset(&command, 0, sizeof(command));
+    command.type = type;
+
+    switch (type)
+    {
+    case COMMAND_ADD_GROUP:
+    case COMMAND_REMOVE_GROUP:
+    case COMMAND_RENAME_GROUP:
+        command.group_id = id;
+        break;
+    case COMMAND_ADD_PORT:
+    case COMMAND_REMOVE_PORT:
+    case COMMAND_RENAME_PORT:
+        command.port_id  = id;
+        command.group_id = arg1;
+        break;
+    case COMMAND_CONNECT_PORTS:
+    case COMMAND_DISCONNECT_PORTS:
+        command.connection_id = id;
+        command.port_out_id = arg1;
+        command.port_in_id  = arg2;
+        break;
+    }
+
+    CanvasCommandSetName(&command, name);
+    return command;
+}
+
+static QVector<canvas_command_t> run(const QVector<canvas_command_t>& commands)
+{
+    CanvasCommandQueue queue;
+
+    foreach (const canvas_command_t& command, commands)
+        queue.push(command);
+
+    QVector<canvas_command_t> result;
+    queue.take(&result);
+    return result;
+}
+
+static void test_group_cancels_contents()
+{
+    // The group never reaches the canvas, neither may its port or the connection to it
+    QVector<canvas_command_t> commands;
+    commands << command(COMMAND_ADD_GROUP, 1)
+             << command(COMMAND_ADD_PORT, 10, 1)
+             << command(COMMAND_CONNECT_PORTS, 100, 10, 20)
+             << command(COMMAND_REMOVE_GROUP, 1);
+
+    CHECK(run(commands).isEmpty());
+
+    // Removals of the contents arriving after the group are dropped as well
+    commands << command(COMMAND_DISCONNECT_PORTS, 100)
+             << command(COMMAND_REMOVE_PORT, 10);
+
+    CHECK(run(commands).isEmpty());
+}
+
+static void test_port_cancels_connections()
+{
+    QVector<canvas_command_t> commands;
+    commands << command(COMMAND_ADD_PORT, 10, 1)
+             << command(COMMAND_CONNECT_PORTS, 100, 20, 10)
+             << command(COMMAND_REMOVE_PORT, 10)
+             << command(COMMAND_DISCONNECT_PORTS, 100);
+
+    CHECK(run(commands).isEmpty());
+}
+
+static void test_unrelated_commands_survive()
+{
+    QVector<canvas_command_t> commands;
+    commands << command(COMMAND_ADD_GROUP, 1)
+             << command(COMMAND_ADD_PORT, 10, 1)
+             << command(COMMAND_ADD_PORT, 11, 2)
+             << command(COMMAND_CONNECT_PORTS, 100, 10, 20)
+             << command(COMMAND_CONNECT_PORTS, 101, 11, 20)
+             << command(COMMAND_REMOVE_GROUP, 1);
+
+    QVector<canvas_command_t> result = run(commands);
+
+    CHECK(result.count() == 2);
+
+    if (result.count() == 2)
+    {
+        CHECK(result[0].type == COMMAND_ADD_PORT && result[0].port_id == 11);
+        CHECK(result[1].type == COMMAND_CONNECT_PORTS && result[1].connection_id == 101);
+    }
+}
+
+static void test_readd_after_cancel()
+{
+    // A reused connection id belongs to the new ports, cancelling the old port leaves it alone
+    QVector<canvas_command_t> commands;
+    commands << command(COMMAND_ADD_PORT, 10, 1)
+             << command(COMMAND_CONNECT_PORTS, 100, 10, 20)
+             << command(COMMAND_DISCONNECT_PORTS, 100)
+             << command(COMMAND_CONNECT_PORTS, 100, 30, 20)
+             << command(COMMAND_REMOVE_PORT, 10);
+
+    QVector<canvas_command_t> result = run(commands);
+
+    CHECK(result.count() == 1);
+
+    if (result.count() == 1)
+        CHECK(result[0].type == COMMAND_CONNECT_PORTS && result[0].port_out_id == 30);
+}
+
+static void test_renames_fold_into_add()
+{
+    QVector<canvas_command_t> commands;
+    commands << command(COMMAND_ADD_PORT, 10, 1, 0, "a")
+             << command(COMMAND_RENAME_PORT, 10, 0, 0, "b")
+             << command(COMMAND_ADD_PORT, 10, 1, 0, "c");
+
+    QVector<canvas_command_t> result = run(commands);
+
+    CHECK(result.count() == 1);
+
+    if (result.count() == 1)
+        CHECK(strcmp(result[0].name, "b") == 0);
+}
+
+int main()
+{
+    test_group_cancels_contents();
+    test_port_cancels_connections();
+    test_unrelated_commands_survive();
+    test_readd_after_cancel();
+    test_renames_fold_into_add();
+
+    if (failures > 0)
+    {
+        std::fprintf(stderr, "%i checks failed\n", failures);
+        return 1;
+    }
+
+    std::printf("all checks passed\n");
+    return 0;
+}